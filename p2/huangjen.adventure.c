@@ -4,25 +4,59 @@
  * Description: generates 7 different room files which contains one room per 
  * file. These files are created in a directory called 
  * huangjen.rooms.<PROCESS_ID_OF_ROOM_PROGRAM>
+ *
+ * the game plays on a World, which is mapped from the world file written by
+ * buildrooms (see huangjen.world.h) so starting doesn't depend on the number
+ * of rooms. directories without a world file are read from the room files.
+ * rooms are looked up by name through a hash index built after loading.
+ * rooms are only named when printed, everything else uses room indexes.
+ *
+ * usage: huangjen.adventure [solve | batch [room directory ...] |
+ *    serve <port | socket path>]
+ *    solve prints the shortest path from the start room to the end room
+ *    batch prints the fewest steps to the end room of each room directory,
+ *    or of the latest one, -1 if the end room can't be reached
+ *    serve plays the game with every player that connects over tcp on port,
+ *    or over a unix socket at socket path. all players share the one world,
+ *    each player only has a Player of their own
+ * while playing, hint names the next room on a shortest path and time
+ * prints the time kept by a clock thread
  * ***************************************************************************/
+#define _GNU_SOURCE // accept4
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <dirent.h> 
 #include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
 #include <pthread.h>
 #include <time.h>
+#include "huangjen.world.h"
 
 #define DIRPREFIX "huangjen.rooms."
 #define TIMEFILEPATH "./currentTime.txt"
 #define BUFFER 32
 #define TIMEBUFFER 256
-#define NAME_LEN 9 // max 8 + \0
-#define NUM_ROOMS 7
+#define PATH_LEN 256  // room directory + file name
+#define NAME_LEN WORLD_NAME_LEN // max 8 + \0
 #define MAX_CONN 6
-#define MAX_PATH 100
+#define PATH_START 16 // rooms path has space for at first
+#define BFS_PARALLEL 65536  // rooms before distances are found with threads
+#define BFS_THREADS 16  // most threads used to find distances
+#define BFS_CHUNK 256  // rooms a thread finds before adding them to next level
+#define BACKLOG 128 // connections waiting to be accepted by server
+#define MAX_EVENTS 64 // epoll events handled at once
+#define SESSION_IN 256  // input of a session not yet played
 
 // room type
 enum room_type {
@@ -30,51 +64,181 @@ enum room_type {
 };
 
 /* ****************************************************************************
- * Description: struct to represent a single instance of a room
+ * Description: the rooms the game is played on, with rooms as indexes. each
+ * room field is its own array, laid out like the sections of the world file,
+ * so walking connections only touches offsets and targets. the arrays point
+ * into the mapped file, or into mem when read from room files
  * ***************************************************************************/
-struct Room {
-  char name[NAME_LEN];
-  char outbounds[MAX_CONN][NAME_LEN];  // names of outbound connections
-  int n;  // number of outbound connections
-  enum room_type type;
+struct World {
+  int n;  // number of rooms
+  uint64_t m;   // number of connections of all rooms
+  const char* names;  // n names of NAME_LEN bytes
+  const uint32_t* offsets;  // connections of room i start at offsets[i]
+  const uint32_t* targets;  // index of connected room
+  const uint8_t* types;   // room_type of each room
+  int start;  // index of start room
+  int end;  // index of end room
+  void* map;  // mapped world file, or NULL
+  size_t mapsize;
+  void* mem;  // arrays built from room files, or NULL
+  uint32_t* hashes;   // hash of each room name
+  uint32_t* index;  // open addressing, room + 1 in each slot, 0 if empty
+  uint32_t mask;  // number of slots in index - 1
 };
 
 /* ****************************************************************************
- * function declarations 
+ * Description: a player of the game, which is all that is kept per player
+ * ***************************************************************************/
+struct Player {
+  int room;   // current location
+  int steps;  // number of steps (rooms visited)
+  int pathsize;
+  int* path;  // rooms visited, doubled when full
+};
+
+/* ****************************************************************************
+ * Description: a player connected to the server. input is played one word
+ * at a time, output waits in out until the socket takes it
+ * ***************************************************************************/
+struct Session {
+  int fd;
+  struct Player player;
+  char in[SESSION_IN];
+  size_t inlen;
+  char* out;
+  size_t outlen;
+  size_t outsent;
+  int done;   // close once out is sent
+  int skip;   // word in in was cut, drop input up to the next space
+};
+
+/* ****************************************************************************
+ * Description: state shared by the threads finding distances to the end
+ * room. rooms connected to room i are rtargets[roffsets[i]] up to
+ * rtargets[roffsets[i + 1]], the connections of the world turned around.
+ * each thread fills them in for the rooms from first up to last of its
+ * BfsThread, then takes its share of the rooms in frontier each level
  * ***************************************************************************/
-// initialization for room
-struct Room* initRooms(const int n);
-void initConnections(struct Room* room);
+struct BfsShare {
+  const struct World* world;
+  int* dist;  // steps from each room to end room, -1 if not found yet
+  int nthreads;
+  pthread_barrier_t barrier;  // between steps and levels
+  uint64_t* roffsets;
+  uint64_t* cursor;  // next free place in rtargets for each room
+  int* rtargets;
+  int* frontier;   // rooms found in the current level
+  int nfrontier;
+  int* next;       // rooms found in the next level
+  int nnext;       // added to by every thread
+};
 
+/* ****************************************************************************
+ * Description: time kept by the clock thread for the time command. display
+ * is guarded by a sequence lock: seq is odd while the clock thread rewrites
+ * display, and a reader that sees seq odd or changed while it copied
+ * display copies it again. readers never block the clock thread or each
+ * other
+ * ***************************************************************************/
+struct Clock {
+  unsigned int seq;
+  char display[TIMEBUFFER];   // formatted time, written one char at a time
+  int stop;   // set to end clock thread
+  int shown;  // time was shown since time file was last written
+  int running;  // clock thread was started
+  pthread_t thread;
+  pthread_mutex_t mutex;  // for stop and waking clock thread
+  pthread_cond_t cond;
+};
+
+struct Clock timeclock = {
+  .seq = 0, .stop = 0, .shown = 0, .running = 0,
+  .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER
+};
+
+struct BfsThread {
+  struct BfsShare* share;
+  int id;
+  int first;
+  int last;
+};
+
+/* ****************************************************************************
+ * function declarations 
+ * ***************************************************************************/
 // file and room info
-struct Room* getRooms(const char* target, int n);
 void getRoomDir(char* roomdir, const char* targetdir);
+int countRoomFiles(const char* loc);
 void getRoomFileNames(char** names, const char* loc, int n);
-void readRoomFiles(struct Room* rooms, char** names, const char* loc, int n);
+void readRoomFiles(char* names, uint8_t* types, uint32_t* offsets, char* conns,
+  char** filenames, const char* loc, int n);
 void parseLine(char* line, char* key, char* val);
 
+// world
+void loadWorld(struct World* world, const char* loc);
+int mapWorld(struct World* world, const char* loc);
+void readWorld(struct World* world, const char* loc);
+void freeWorld(struct World* world);
+uint32_t hashname(const char* name);
+void indexWorld(struct World* world);
+const char* roomName(const struct World* world, int room);
+int connections(const struct World* world, int room, uint32_t* first,
+  uint32_t* last);
+
 // print
-void printConnections(const struct Room* room);
-void printPath(char** path, int n);
+void printConnections(FILE* out, const struct World* world, int room);
+void printPath(FILE* out, const struct World* world, const int* path, int n);
 void exitDirAccessError();
-void printRooms(const struct Room* rooms, int n);
-void printtime();
+void printWorld(const struct World* world);
 
 // type helpers
 char* typeStr(enum room_type type);
 enum room_type typeFromStr(char* str);
 
 // game play
-void startGame(struct Room* rooms, int n, struct Room* startroom);
-struct Room* getStartRoom(struct Room* rooms, int n);
-struct Room* findRoom(struct Room* rooms, int n, const char* search);
+void startGame(const struct World* world);
+int findRoom(const struct World* world, const char* search);
+int isConnected(const struct World* world, int room, int target);
+int readInput(char* input);
+void initPlayer(struct Player* player, const struct World* world);
+void printPrompt(FILE* out, const struct World* world,
+  const struct Player* player);
+int playInput(FILE* out, const struct World* world, struct Player* player,
+  int** dist, const char* input);
+
+// server
+void serve(const struct World* world, const char* addr);
+int openListener(const char* addr);
+void acceptSessions(int listener, int epfd, const struct World* world);
+void readSession(struct Session* session, int epfd,
+  const struct World* world, int** dist);
+void writeSession(struct Session* session, int epfd);
+void closeSession(struct Session* session, int epfd);
+
+// shortest paths
+int* endDistances(const struct World* world);
+void* bfsWorker(void* arg);
+void bfsAdd(struct BfsShare* share, const int* found, int count);
+int nextRoom(const struct World* world, const int* dist, int room);
+void printHint(FILE* out, const struct World* world, const int* dist,
+  int room);
+void solve(const struct World* world);
 
 // time threading
-int timethread(pthread_mutex_t* mutex);
-void* createTimeFile();
+void startClock();
+void stopClock();
+void* clockWorker(void* arg);
+void formatTime(char* display);
+void setClock(const char* display);
+void readClock(char* display);
+void showClock(char* display);
+void createTimeFile(const char* display);
+void flushClock(char* written);
 
 /* ****************************************************************************
- * Description: opens the current directory and loops through each file/
+ * Description: sets roomdir to the directory LATESTLINK points to. if there
+ * is no such directory, which happens with rooms from an older buildrooms,
+ * opens the current directory and loops through each file/
  * subdirectory inside it looking for the entries that begins with the target
  * pathname. Gets the last modified timestamp of it, records the name and 
  * timestamp, and compares these to previously held entries and stores the 
@@ -84,9 +248,20 @@ void* createTimeFile();
  * @param targetdir target directory prefix
  * ***************************************************************************/
 void getRoomDir(char* roomdir, const char* targetdir) { 
-  time_t latest;  // timestamp of latest subdir examined
+  time_t latest = 0;  // timestamp of latest subdir examined
   char newestdir[BUFFER]; // holds the name of newest dir that contains prefix
-  memset(roomdir, '\0', sizeof(roomdir)); // clear directory string 
+  memset(roomdir, '\0', BUFFER); // clear directory string 
+
+  // follow link to latest directory, without looking at any other
+  ssize_t len = readlink(LATESTLINK, newestdir, sizeof(newestdir) - 1);
+  struct stat linked;
+  if (len > 0) {
+    newestdir[len] = '\0';
+    if (stat(newestdir, &linked) == 0 && S_ISDIR(linked.st_mode)) {
+      strcpy(roomdir, newestdir);
+      return;
+    }
+  }
 
   DIR* tocheck; // start directory
   struct dirent* dirfile; // current subdir of starting dir
@@ -101,8 +276,9 @@ void getRoomDir(char* roomdir, const char* targetdir) {
 
   // check each entry in directory
   while ( (dirfile = readdir(tocheck)) != NULL) {
-    // if there's a match for target directory
-    if (strstr(dirfile->d_name, targetdir) != NULL) {
+    // if there's a match for target directory, other than the link
+    if (strncmp(dirfile->d_name, targetdir, strlen(targetdir)) == 0 &&
+        strcmp(dirfile->d_name, LATESTLINK) != 0) {
       // printf("Found prefix: %s\n", dirfile->d_name);
 
       // get attribute of entry
@@ -112,7 +288,7 @@ void getRoomDir(char* roomdir, const char* targetdir) {
       if (dirattribute.st_mtime > latest ) {
         // set latest time and directory
         latest = dirattribute.st_mtime;
-        memset(roomdir, '\0', sizeof(roomdir));
+        memset(roomdir, '\0', BUFFER);
         strcpy(roomdir, dirfile->d_name);
         // printf("newer subdir: %s, new time: %d\n", dirfile->d_name, latest);
       }
@@ -123,34 +299,23 @@ void getRoomDir(char* roomdir, const char* targetdir) {
 }
 
 /* ****************************************************************************
- * Description: initializes room connections to null and connection count to 0
- * @param room
+ * Description: returns number of room files in directory loc
+ * @param loc
  * ***************************************************************************/
-void initConnections(struct Room* room) {
-  room->n = 0;
-  int i = 0;
-  for (; i < MAX_CONN; i++) {
-    char* conn = room->outbounds[i];
-    memset(conn, '\0', sizeof(conn));
+int countRoomFiles(const char* loc) {
+  DIR* dir = opendir(loc); // pointer to directory
+  if (dir == NULL) {
+    exitDirAccessError();
+    exit(100);
   }
-}
-
-/* ****************************************************************************
- * Description: initialize rooms
- * @param dir
- * ***************************************************************************/
-struct Room* initRooms(const int n) {
-  struct Room* rooms = (struct Room*) malloc(sizeof(struct Room) * NUM_ROOMS);
 
-  int i = 0;
-  for (; i < n; i++) {
-    struct Room* room = &rooms[i];
-    memset(room->name, '\0', sizeof(room->name));   // null room name
-    initConnections(room);    // initialize connections
-    room->type = MID_ROOM;    // default to mid
+  struct dirent* file;
+  int ct = 0;
+  while ( (file = readdir(dir)) != NULL) {
+    if (isalpha(file->d_name[0])) ct++;  // same files getRoomFileNames reads
   }
-
-  return rooms;
+  closedir(dir);
+  return ct;
 }
 
 /* ****************************************************************************
@@ -168,11 +333,11 @@ void getRoomFileNames(char** names, const char* loc, int n) {
 
   struct dirent* file;
   int ct = 0;
-  while ( (file = readdir(dir)) != NULL) {
+  while (ct < n && (file = readdir(dir)) != NULL) {
     if (!isalpha(file->d_name[0])) continue;  // ignore "." and ".."
     // save file names  
-    memset(names[ct], '\0', sizeof(names[ct]));
-    sprintf(names[ct], "%s\0", file->d_name);
+    memset(names[ct], '\0', NAME_LEN);
+    snprintf(names[ct], NAME_LEN, "%s", file->d_name);
     ct++;
   }
 
@@ -183,15 +348,29 @@ void getRoomFileNames(char** names, const char* loc, int n) {
   closedir(dir);
 }
 
-void readRoomFiles(struct Room* rooms, char** names, const char* loc, int n) {
-  char filepath[BUFFER];
+/* ****************************************************************************
+ * Description: reads room files into the room arrays. names of connections
+ * are saved to conns, NAME_LEN bytes each, with the connections of room i
+ * from offsets[i] up to offsets[i + 1]
+ * @param names
+ * @param types
+ * @param offsets
+ * @param conns
+ * @param filenames
+ * @param loc
+ * @param n
+ * ***************************************************************************/
+void readRoomFiles(char* names, uint8_t* types, uint32_t* offsets, char* conns,
+    char** filenames, const char* loc, int n) {
+  char filepath[PATH_LEN];
   FILE* roomfile;
+  uint32_t m = 0;   // connections read
 
   int i = 0;
   for (; i < n; i++) {
     // open file
     memset(filepath, '\0', sizeof(filepath));
-    sprintf(filepath, "./%s/%s", loc, names[i]);
+    snprintf(filepath, sizeof(filepath), "%s/%s", loc, filenames[i]);
     // printf("filepath: %s\n", filepath);
 
     roomfile = fopen(filepath, "r+");
@@ -201,7 +380,8 @@ void readRoomFiles(struct Room* rooms, char** names, const char* loc, int n) {
       exit(EXIT_FAILURE);
     }
 
-    struct Room* room = &rooms[i];
+    offsets[i] = m;
+    types[i] = MID_ROOM;  // default to mid
 
     // PARSE FILE
     char line[BUFFER];    // holds line of file
@@ -222,18 +402,15 @@ void readRoomFiles(struct Room* rooms, char** names, const char* loc, int n) {
     // set room info based on key
       // name
       if (strcmp(key, "ROOM NAME") == 0) {          
-        sprintf(room->name, "%s\0", val);
-        // printf("room->name set: %s\n", room->name);
+        snprintf(names + NAME_LEN * i, NAME_LEN, "%s", val);
       } 
       // connections
-      if (strcmp(key, "CONNECTION ") == 0) {   
-        sprintf(room->outbounds[room->n++], "%s\0", val);
-        // printf("room connection added: %s\n", room->outbounds[room->n - 1]);
+      if (strcmp(key, "CONNECTION ") == 0 && m - offsets[i] < MAX_CONN) {   
+        snprintf(conns + (size_t) NAME_LEN * m++, NAME_LEN, "%s", val);
       }
       // room_type
       if (strcmp(key, "ROOM TYPE") == 0) {
-        room->type = typeFromStr(val);
-        // printf("room type set: %s\n", typeStr(room->type)); 
+        types[i] = typeFromStr(val);
       }
 
       // reset line buffer
@@ -242,10 +419,8 @@ void readRoomFiles(struct Room* rooms, char** names, const char* loc, int n) {
 
     // close file
     fclose(roomfile);
-            // printf("\n");
   }
-
-  // printRooms(rooms, n);
+  offsets[n] = m;
 }
 
 /* ****************************************************************************
@@ -268,72 +443,264 @@ void parseLine(char* line, char* key, char* val) {
 }
 
 /* ****************************************************************************
- * Description: retrieves and sets room information from files
- * @param rooms
- * @param loc
- * @param n
+ * Description: loads world of room directory loc, mapping its world file if
+ * it has one and reading its room files otherwise
+ * @param world
+ * @param loc room directory
+ * ***************************************************************************/
+void loadWorld(struct World* world, const char* loc) {
+  if (mapWorld(world, loc) == 0) {
+    indexWorld(world);
+    return;
+  }
+
+  // no usable world file, read room files
+  readWorld(world, loc);
+}
+
+/* ****************************************************************************
+ * Description: maps the world file of directory loc into world. only the
+ * header is checked here so mapping takes the same time for any number of
+ * rooms, connections are checked as they're used in connections(). returns
+ * 0 on success and -1 if there's no usable world file
+ * @param world
+ * @param loc room directory
+ * ***************************************************************************/
+int mapWorld(struct World* world, const char* loc) {
+  char path[PATH_LEN];
+  snprintf(path, sizeof(path), "%s/%s", loc, WORLDFILE);
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(struct WorldHeader)) {
+    close(fd);
+    return -1;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // mapping stays after close
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+
+  // check header and that each section is inside the file
+  const struct WorldHeader* h = (const struct WorldHeader*) map;
+  uint64_t size = st.st_size;
+  if (memcmp(h->magic, WORLDMAGIC, sizeof(h->magic)) != 0 ||
+      h->version != WORLDVERSION || h->byteorder != WORLDBYTEORDER ||
+      h->namelen != NAME_LEN || h->size != size || h->n == 0 ||
+      h->n > INT32_MAX || h->start >= h->n || h->end >= h->n ||
+      h->offsets % 4 != 0 || h->targets % 4 != 0 ||
+      h->names > size || (size - h->names) / NAME_LEN < h->n ||
+      h->offsets > size || (size - h->offsets) / 4 < (uint64_t) h->n + 1 ||
+      h->targets > size || (size - h->targets) / 4 < h->m ||
+      h->types > size || size - h->types < h->n) {
+    fprintf(stderr, "%s is not a valid world file, reading room files\n",
+      path);
+    munmap(map, st.st_size);
+    return -1;
+  }
+
+  world->n = h->n;
+  world->m = h->m;
+  world->names = (const char*) map + h->names;
+  world->offsets = (const uint32_t*) ((const char*) map + h->offsets);
+  world->targets = (const uint32_t*) ((const char*) map + h->targets);
+  world->types = (const uint8_t*) map + h->types;
+  world->start = h->start;
+  world->end = h->end;
+  world->map = map;
+  world->mapsize = st.st_size;
+  world->mem = NULL;
+
+  // the game jumps between rooms, so don't read ahead
+  madvise(map, st.st_size, MADV_RANDOM);
+  return 0;
+}
+
+/* ****************************************************************************
+ * Description: reads world from the room files of directory loc into arrays
+ * laid out the same way as the world file. connections are stored by name in
+ * room files, they're turned into room indexes once all names are read
+ * @param world
+ * @param loc room directory
  * ***************************************************************************/
-void setRoomInfo(struct Room* rooms, const char* loc, int n) {
+void readWorld(struct World* world, const char* loc) {
+  int n = countRoomFiles(loc);
+
   // allocate space to store all room file names
   char** filenames = (char**) malloc(sizeof(char*) * n);
-  int m = 0; 
-  for (; m < n; m++) {
+  int i = 0; 
+  for (; i < n; i++) {
     // space for each file name
-    filenames[m] = (char*) malloc(sizeof(char) * (NAME_LEN));
+    filenames[i] = (char*) malloc(sizeof(char) * (NAME_LEN));
   }
-
-  // get the file names
   getRoomFileNames(filenames, loc, n);
-  // int i = 0; for (; i < n; i++) printf("filenames %d: %s\n", i+1, filenames[i]);
 
-  // read files for room info
-  readRoomFiles(rooms, filenames, loc, n);
+  // one block for all arrays, offsets and targets first for alignment
+  size_t maxconn = (size_t) n * MAX_CONN;
+  size_t size = sizeof(uint32_t) * (n + 1 + maxconn) + (NAME_LEN + 1) * n;
+  char* mem = (char*) calloc(1, size);
+  char* conns = (char*) calloc(maxconn, NAME_LEN);  // until turned to indexes
+  if (mem == NULL || conns == NULL) {
+    perror("error: could not allocate rooms");
+    exit(1);
+  }
+  uint32_t* offsets = (uint32_t*) mem;
+  uint32_t* targets = offsets + n + 1;
+  char* names = (char*) (targets + maxconn);
+  uint8_t* types = (uint8_t*) (names + NAME_LEN * n);
 
-  // free file names
-  int f = 0; for (; f < n; f++) free(filenames[f]);
+  // read files for room info
+  readRoomFiles(names, types, offsets, conns, filenames, loc, n);
+  for (i = 0; i < n; i++) free(filenames[i]);
   free(filenames);
+
+  world->n = n;
+  world->names = names;
+  world->types = types;
+  world->start = -1;
+  world->end = -1;
+  for (i = 0; i < n; i++) {
+    if (types[i] == START_ROOM) world->start = i;
+    if (types[i] == END_ROOM) world->end = i;
+  }
+  if (world->start == -1) {
+    perror("error: could not set start room. Proceeding to exit\n");
+    exit(101);
+  }
+  indexWorld(world);
+
+  // look up connection names, dropping ones that aren't rooms
+  uint32_t m = 0;
+  for (i = 0; i < n; i++) {
+    uint32_t first = offsets[i];
+    uint32_t last = offsets[i + 1];
+    offsets[i] = m;
+    for (; first < last; first++) {
+      int target = findRoom(world, conns + (size_t) NAME_LEN * first);
+      if (target != -1) targets[m++] = target;
+    }
+  }
+  offsets[n] = m;
+  free(conns);
+
+  world->offsets = offsets;
+  world->targets = targets;
+  world->m = m;
+  world->map = NULL;
+  world->mapsize = 0;
+  world->mem = mem;
 }
 
 /* ****************************************************************************
- * Description: returns rooms retrieved from files
- * @param dir
+ * Description: unmaps or frees world
+ * @param world
  * ***************************************************************************/
-struct Room* getRooms(const char* target, int n) {
-  // get latest room file directory
-  char location[BUFFER];
-  // sprintf(location, "./%s", roomdir);
-  getRoomDir(location, target);
-  // printf("getRooms() location = %s\n", location);
+void freeWorld(struct World* world) {
+  if (world->map != NULL) {
+    munmap(world->map, world->mapsize);
+  }
+  free(world->mem);
+  free(world->hashes);
+  free(world->index);
+  memset(world, 0, sizeof(*world));
+}
 
-  // initialize rooms
-  struct Room* rooms = initRooms(n);
+/* ****************************************************************************
+ * Description: returns hash of room name (fnv-1a), reading at most
+ * NAME_LEN - 1 characters since names in the world file may not end in \0
+ * @param name
+ * ***************************************************************************/
+uint32_t hashname(const char* name) {
+  uint32_t h = 2166136261u;
+  int i = 0;
+  for (; i < NAME_LEN - 1 && name[i] != '\0'; i++) {
+    h = (h ^ (unsigned char) name[i]) * 16777619u;
+  }
+  return h;
+}
 
-  // retrieve room info 
-  setRoomInfo(rooms, location, n);
+/* ****************************************************************************
+ * Description: builds the hash index of room names. the index has at least
+ * twice as many slots as rooms so probes stay short, and keeps the hash of
+ * each name so most probes are decided without comparing names. if two
+ * rooms have the same name the first one is found
+ * @param world
+ * ***************************************************************************/
+void indexWorld(struct World* world) {
+  uint32_t slots = 2;
+  while (slots < (uint32_t) world->n * 2) slots <<= 1;
+  world->mask = slots - 1;
+  world->hashes = (uint32_t*) malloc(sizeof(uint32_t) * world->n);
+  world->index = (uint32_t*) calloc(slots, sizeof(uint32_t));
+  if (world->hashes == NULL || world->index == NULL) {
+    perror("error: could not allocate room index");
+    exit(1);
+  }
 
-  return rooms;
+  int i = 0;
+  for (; i < world->n; i++) {
+    uint32_t h = hashname(roomName(world, i));
+    world->hashes[i] = h;
+    uint32_t slot = h & world->mask;
+    while (world->index[slot] != 0) slot = (slot + 1) & world->mask;
+    world->index[slot] = i + 1;
+  }
+}
+
+/* ****************************************************************************
+ * Description: returns name of room. names are NAME_LEN bytes and may not
+ * end in \0 in a damaged world file, so print them with %.*s
+ * @param world
+ * @param room
+ * ***************************************************************************/
+const char* roomName(const struct World* world, int room) {
+  return world->names + (size_t) NAME_LEN * room;
+}
+
+/* ****************************************************************************
+ * Description: sets the range of targets holding connections of room, and
+ * returns 0, or -1 if the range is not valid
+ * @param world
+ * @param room
+ * @param first
+ * @param last one past the last connection
+ * ***************************************************************************/
+int connections(const struct World* world, int room, uint32_t* first,
+    uint32_t* last) {
+  *first = world->offsets[room];
+  *last = world->offsets[room + 1];
+  if (*first > *last || *last > world->m) {
+    *first = *last = 0;
+    return -1;
+  }
+  return 0;
 }
 
 /* ****************************************************************************
  * Description: prints information for rooms, used for debugging
- * @param rooms
- * @param n: number of rooms
+ * @param world
  * ***************************************************************************/
-void printRooms(const struct Room* rooms, int n) {
+void printWorld(const struct World* world) {
   int i;
-  for (i = 0; i < n; i++) {
-    const struct Room* room = &rooms[i];
+  for (i = 0; i < world->n; i++) {
     // print room name
-    printf("ROOM NAME: %s\n", room->name);
+    printf("ROOM NAME: %.*s\n", NAME_LEN, roomName(world, i));
 
     // print connections
-    int j;
-    for (j = 0; j < room->n; j++) {
-      printf("CONNECTION %d: %s\n", j + 1, room->outbounds[j]);
+    uint32_t j, last;
+    connections(world, i, &j, &last);
+    int ct = 1;
+    for (; j < last; j++) {
+      printf("CONNECTION %d: %.*s\n", ct++, NAME_LEN,
+        roomName(world, world->targets[j]));
     }
 
     // print room type
-    printf("ROOM TYPE: %s\n\n", typeStr(room->type));
+    printf("ROOM TYPE: %s\n\n", typeStr(world->types[i]));
   }
   return;
 }
@@ -379,251 +746,939 @@ void exitDirAccessError() {
 
 /* ****************************************************************************
  * Description: print connections in the correct format for game
- * @param rooms
+ * @param out
+ * @param world
+ * @param room
  * ***************************************************************************/
-void printConnections(const struct Room* room) {
-  int i = 0;
-  for (; i < room->n; i++) {
-    if (i == room->n - 1) {
-      printf("%s.\n", room->outbounds[i]);
-    } else {
-      printf("%s, ", room->outbounds[i]);
-    }
+void printConnections(FILE* out, const struct World* world, int room) {
+  uint32_t i, last;
+  connections(world, room, &i, &last);
+  for (; i < last; i++) {
+    uint32_t target = world->targets[i];
+    if (target >= (uint32_t) world->n) continue;  // damaged world file
+    fprintf(out, "%.*s%s", NAME_LEN, roomName(world, target),
+      i == last - 1 ? ".\n" : ", ");
   }
 }
 
 /* ****************************************************************************
  * Description: print path
- * @param path
- * @param n
- * ***************************************************************************/
-void printPath(char** path, int n) {
-  int i = 0;
-  for (; i < n; i++) {
-    printf("%d\t%s\n", i + 1, path[i]);
-  }
-}
-
-/* ****************************************************************************
- * Description: returns pointer to the start room 
- * @param rooms
+ * @param out
+ * @param world
+ * @param path rooms visited
  * @param n
  * ***************************************************************************/
-struct Room* getStartRoom(struct Room* rooms, int n) {
-  if (rooms == NULL) {
-    return NULL;
-  }
-
-  // go through rooms looking for room type to be START_ROOM
+void printPath(FILE* out, const struct World* world, const int* path, int n) {
   int i = 0;
   for (; i < n; i++) {
-    struct Room* room = &rooms[i];
-    if (room->type == START_ROOM) {
-      return &rooms[i];
-    }
+    fprintf(out, "%d\t%.*s\n", i + 1, NAME_LEN, roomName(world, path[i]));
   }
-  return NULL;
 }
 
 /* ****************************************************************************
- * Description: returns pointer to room of a searched name, 
- * returns NULL if not found
- * @param rooms
- * @param n
+ * Description: returns index of room of a searched name, 
+ * returns -1 if not found
+ * @param world
  * @param name
  * ***************************************************************************/
-struct Room* findRoom(struct Room* rooms, int n, const char* search) {
-  // check if rooms exist
-  if (rooms == NULL) {
-    return NULL;
+int findRoom(const struct World* world, const char* search) {
+  // names longer than a room name can't match
+  if (strlen(search) >= NAME_LEN) {
+    return -1;
   }
 
-  // search through rooms for room specified by search
-  int i = 0;
-  for (; i < n; i++) {
-    struct Room* room = &rooms[i];
+  // probe index from slot of hash until an empty slot
+  uint32_t h = hashname(search);
+  uint32_t slot = h & world->mask;
+  for (; world->index[slot] != 0; slot = (slot + 1) & world->mask) {
+    int room = world->index[slot] - 1;
     // check if name matches search
-    if (strcmp(search, room->name) == 0) {
+    if (world->hashes[room] == h &&
+        strncmp(search, roomName(world, room), NAME_LEN - 1) == 0) {
       // the room was found
       return room;
     }
   }
 
   // room was not found
-  return NULL;
+  return -1;
 }
 
 /* ****************************************************************************
- * Description: function for running room game
- * @param rooms
- * @param n
- * @param startroom
+ * Description: returns 1 if target is a connection of room, 0 otherwise
+ * @param world
+ * @param room
+ * @param target
  * ***************************************************************************/
-void startGame(struct Room* rooms, int n, struct Room* startroom) {
-  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-  // track user's current location
-  struct Room* currloc = startroom;
-
-  // track number of steps (rooms visited)
-  int steps = 0;  
-
-  // set up for player's path
-  char** path = (char**) malloc(sizeof(char*) * MAX_PATH);
-  int m = 0;
-  for (; m < MAX_PATH; m++) {
-    // space for each room in path
-    path[m] = (char*) malloc(sizeof(char) * NAME_LEN);
-    memset(path[m], '\0', sizeof(path[m]));
+int isConnected(const struct World* world, int room, int target) {
+  uint32_t i, last;
+  connections(world, room, &i, &last);
+  for (; i < last; i++) {
+    if (world->targets[i] == (uint32_t) target) {
+      return 1;
+    }
   }
+  return 0;
+}
+
+/* ****************************************************************************
+ * Description: function for running room game
+ * @param world
+ * ***************************************************************************/
+void startGame(const struct World* world) {
+  startClock();
+  struct Player player;
+  initPlayer(&player, world);
 
   // track user's input
   char input[BUFFER];
   memset(input, '\0', sizeof(input));
 
-  while (currloc->type != END_ROOM) {
-    // print current location
-    printf("CURRENT LOCATION: %s\n", currloc->name);
-    // print connections
-    printf("POSSIBLE CONNECTIONS: ");
-    printConnections(currloc);
-    // print prompt for next location
-    printf("WHERE TO? >");
-    // scan input
-    scanf("%s", input);
-    
-    // check for time input
-    while (strcmp(input, "time") == 0) {
-      // thread and print time
-      int thrdstat = timethread(&mutex);
-      if (thrdstat != 0) {
-        printtime();
-      }
-      // print prompt for next location
-      printf("WHERE TO? >");
-      // scan input
-      scanf("%s", input);
+  // steps from each room to end room, found on first hint
+  int* dist = NULL;
+
+  printPrompt(stdout, world, &player);
+  // scan input, stop if there's no more
+  while (readInput(input)) {
+    if (playInput(stdout, world, &player, &dist, input)) break;
+  }
+
+  // free path mem
+  free(player.path);
+  free(dist);
+
+  stopClock();
+}
+
+/* ****************************************************************************
+ * Description: puts player in the start room with an empty path
+ * @param player
+ * @param world
+ * ***************************************************************************/
+void initPlayer(struct Player* player, const struct World* world) {
+  player->room = world->start;
+  player->steps = 0;
+  player->pathsize = PATH_START;
+  player->path = (int*) malloc(sizeof(int) * player->pathsize);
+}
+
+/* ****************************************************************************
+ * Description: prints current location and connections of player and asks
+ * where to go
+ * @param out
+ * @param world
+ * @param player
+ * ***************************************************************************/
+void printPrompt(FILE* out, const struct World* world,
+    const struct Player* player) {
+  // print current location
+  fprintf(out, "CURRENT LOCATION: %.*s\n", NAME_LEN,
+    roomName(world, player->room));
+  // print connections
+  fprintf(out, "POSSIBLE CONNECTIONS: ");
+  printConnections(out, world, player->room);
+  // print prompt for next location
+  fprintf(out, "WHERE TO? >");
+}
+
+/* ****************************************************************************
+ * Description: plays one word of input of player: time, hint or a room to
+ * go to, and prints the response, ending with the next prompt. returns 1
+ * when player reaches the end room, 0 otherwise
+ * @param out
+ * @param world
+ * @param player
+ * @param dist steps from each room to end room, found on first hint
+ * @param input
+ * ***************************************************************************/
+int playInput(FILE* out, const struct World* world, struct Player* player,
+    int** dist, const char* input) {
+  // check for time and hint input
+  if (strcmp(input, "time") == 0 || strcmp(input, "hint") == 0) {
+    if (strcmp(input, "time") == 0) {
+      // print time kept by clock thread
+      char display[TIMEBUFFER];
+      showClock(display);
+      fprintf(out, "\n%s\n\n", display);
+    } else {
+      // distances are found on first hint, then each hint is one lookup
+      if (*dist == NULL) *dist = endDistances(world);
+      printHint(out, world, *dist, player->room);
     }
+    // print prompt for next location
+    fprintf(out, "WHERE TO? >");
+    return 0;
+  }
+  fprintf(out, "\n");
+
+  // validate user input, only connections of current room can be entered
+  int next = findRoom(world, input);
+  if (next == -1 || !isConnected(world, player->room, next)) { 
+    fprintf(out, "HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+    printPrompt(out, world, player);
+    return 0;
+  } 
+
+  player->room = next;
+  if (player->steps == player->pathsize) {
+    player->pathsize *= 2;
+    player->path = (int*) realloc(player->path,
+      sizeof(int) * player->pathsize);
+  }
+  player->path[player->steps++] = next;
+
+  // print victory message
+  if (world->types[next] == END_ROOM) {
+    fprintf(out, "YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
+    fprintf(out, "YOU TOOK %d STEP(S). YOUR PATH TO VICTORY WAS:\n",
+      player->steps);
+    printPath(out, world, player->path, player->steps);
+    return 1;
+  }
+  printPrompt(out, world, player);
+  return 0;
+}
+
+/* ****************************************************************************
+ * Description: reads a word of input, returns 0 if there's no more input
+ * @param input BUFFER bytes
+ * ***************************************************************************/
+int readInput(char* input) {
+  if (scanf("%31s", input) != 1) {
     printf("\n");
+    return 0;
+  }
+  return 1;
+}
 
+/* ****************************************************************************
+ * Description: returns the number of steps from each room to the end room,
+ * -1 for rooms it can't be reached from. this is a breadth first search from
+ * the end room going backwards over connections, one level at a time: the
+ * rooms found in a level are the frontier, and only their connections are
+ * looked at for the next level, so each connection is followed once. large
+ * worlds split the work between threads with a barrier between levels
+ * @param world
+ * ***************************************************************************/
+int* endDistances(const struct World* world) {
+  int* dist = (int*) malloc(sizeof(int) * world->n);
+  if (dist == NULL) {
+    perror("error: could not allocate distances");
+    exit(1);
+  }
+  int i = 0;
+  for (; i < world->n; i++) dist[i] = -1;
+  if (world->end == -1) {
+    return dist;  // no end room
+  }
+  dist[world->end] = 0;
+
+  struct BfsShare share;
+  share.world = world;
+  share.dist = dist;
+  share.roffsets = (uint64_t*) calloc(world->n + 1, sizeof(uint64_t));
+  share.cursor = (uint64_t*) malloc(sizeof(uint64_t) * world->n);
+  share.rtargets = NULL;  // size is known once connections are counted
+  share.frontier = (int*) malloc(sizeof(int) * world->n);
+  share.next = (int*) malloc(sizeof(int) * world->n);
+  if (share.roffsets == NULL || share.cursor == NULL ||
+      share.frontier == NULL || share.next == NULL) {
+    perror("error: could not allocate distances");
+    exit(1);
+  }
+  share.frontier[0] = world->end;
+  share.nfrontier = 1;
+  share.nnext = 0;
+
+  // use threads only when there are enough rooms to pay for them
+  share.nthreads = 1;
+  if (world->n >= BFS_PARALLEL) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    share.nthreads = cpus < 1 ? 1 : cpus > BFS_THREADS ? BFS_THREADS : cpus;
+  }
+  pthread_barrier_init(&share.barrier, NULL, share.nthreads);
+
+  pthread_t threads[BFS_THREADS];
+  struct BfsThread args[BFS_THREADS];
+  for (i = 0; i < share.nthreads; i++) {
+    args[i].share = &share;
+    args[i].id = i;
+    args[i].first = (int) ((int64_t) world->n * i / share.nthreads);
+    args[i].last = (int) ((int64_t) world->n * (i + 1) / share.nthreads);
+  }
+  // this thread takes the first rooms
+  for (i = 1; i < share.nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, bfsWorker, &args[i]) != 0) {
+      perror("error: thread could not be created\n");
+      exit(1);
+    }
+  }
+  bfsWorker(&args[0]);
+  for (i = 1; i < share.nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_barrier_destroy(&share.barrier);
+  free(share.roffsets);
+  free(share.cursor);
+  free(share.rtargets);
+  free(share.frontier);
+  free(share.next);
+  return dist;
+}
 
-    // validate user input
-    if (findRoom(rooms, n, input) == NULL) { 
-      printf("HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
-      continue;
-    } 
+/* ****************************************************************************
+ * Description: adds rooms found by one thread to the next level
+ * @param share
+ * @param found
+ * @param count
+ * ***************************************************************************/
+void bfsAdd(struct BfsShare* share, const int* found, int count) {
+  if (count == 0) return;
+  int at = __atomic_fetch_add(&share->nnext, count, __ATOMIC_RELAXED);
+  memcpy(share->next + at, found, sizeof(int) * count);
+}
 
-    // sprintf(path[steps], "%s\0", currloc->name);
-    currloc = findRoom(rooms, n, input);
-    strcpy(path[steps++], currloc->name);
+/* ****************************************************************************
+ * Description: turns the connections of one thread's rooms around, then
+ * expands its share of each level's frontier until a level finds no rooms.
+ * a room is claimed by the first thread to change its distance from -1, so
+ * it goes into the next level once
+ * @param arg BfsThread
+ * ***************************************************************************/
+void* bfsWorker(void* arg) {
+  struct BfsThread* self = (struct BfsThread*) arg;
+  struct BfsShare* share = self->share;
+  const struct World* world = share->world;
+  int* dist = share->dist;
+  uint32_t j, last, target;
+  int room, i;
+
+  // count connections into each room
+  for (room = self->first; room < self->last; room++) {
+    connections(world, room, &j, &last);
+    for (; j < last; j++) {
+      target = world->targets[j];
+      if (target < (uint32_t) world->n) {
+        __atomic_fetch_add(&share->roffsets[target + 1], 1, __ATOMIC_RELAXED);
+      }
+    }
+  }
+  pthread_barrier_wait(&share->barrier);
+  if (self->id == 0) {
+    for (i = 0; i < world->n; i++) {
+      share->roffsets[i + 1] += share->roffsets[i];
+    }
+    memcpy(share->cursor, share->roffsets, sizeof(uint64_t) * world->n);
+    uint64_t total = share->roffsets[world->n];
+    share->rtargets = (int*) malloc(sizeof(int) * (total + 1));
+    if (share->rtargets == NULL) {
+      perror("error: could not allocate distances");
+      exit(1);
+    }
+  }
+  pthread_barrier_wait(&share->barrier);
+  for (room = self->first; room < self->last; room++) {
+    connections(world, room, &j, &last);
+    for (; j < last; j++) {
+      target = world->targets[j];
+      if (target < (uint32_t) world->n) {
+        uint64_t at = __atomic_fetch_add(&share->cursor[target], 1,
+                                         __ATOMIC_RELAXED);
+        share->rtargets[at] = room;
+      }
+    }
   }
+  pthread_barrier_wait(&share->barrier);
+
+  int found[BFS_CHUNK];
+  int level = 0;
+  // nfrontier only changes between the two barriers, so all threads stop
+  // at the same level
+  for (; share->nfrontier > 0; level++) {
+    int first = (int) ((int64_t) share->nfrontier * self->id / share->nthreads);
+    int end = (int) ((int64_t) share->nfrontier * (self->id + 1) /
+                     share->nthreads);
+    int count = 0;
+    for (i = first; i < end; i++) {
+      int to = share->frontier[i];
+      uint64_t k = share->roffsets[to];
+      for (; k < share->roffsets[to + 1]; k++) {
+        int from = share->rtargets[k];
+        int unseen = -1;
+        if (__atomic_compare_exchange_n(&dist[from], &unseen, level + 1, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          found[count++] = from;
+          if (count == BFS_CHUNK) {
+            bfsAdd(share, found, count);
+            count = 0;
+          }
+        }
+      }
+    }
+    bfsAdd(share, found, count);
+
+    pthread_barrier_wait(&share->barrier);
+    if (self->id == 0) {
+      int* swap = share->frontier;
+      share->frontier = share->next;
+      share->next = swap;
+      share->nfrontier = share->nnext;
+      share->nnext = 0;
+    }
+    pthread_barrier_wait(&share->barrier);
+  }
+  return NULL;
+}
 
-  // print victory message
-  if (currloc->type == END_ROOM) {
-    // print victory
-    printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
-    printf("YOU TOOK %d STEP(S). YOUR PATH TO VICTORY WAS:\n", steps);
-    printPath(path, steps);
+/* ****************************************************************************
+ * Description: returns a connection of room that is one step closer to the
+ * end room, or -1 if room is the end room or the end room can't be reached
+ * @param world
+ * @param dist from endDistances()
+ * @param room
+ * ***************************************************************************/
+int nextRoom(const struct World* world, const int* dist, int room) {
+  if (dist[room] <= 0) {
+    return -1;
+  }
+  uint32_t i, last;
+  connections(world, room, &i, &last);
+  for (; i < last; i++) {
+    uint32_t target = world->targets[i];
+    if (target < (uint32_t) world->n && dist[target] == dist[room] - 1) {
+      return target;
+    }
   }
+  return -1;
+}
 
-  // free path mem
-  int f = 0; for (; f < MAX_PATH; f++) free(path[f]);
-  free(path);
+/* ****************************************************************************
+ * Description: prints next room on a shortest path to the end room
+ * @param out
+ * @param world
+ * @param dist from endDistances()
+ * @param room current room
+ * ***************************************************************************/
+void printHint(FILE* out, const struct World* world, const int* dist,
+    int room) {
+  int next = nextRoom(world, dist, room);
+  if (next == -1) {
+    fprintf(out, "\nTHE END ROOM CAN'T BE REACHED FROM HERE.\n\n");
+    return;
+  }
+  fprintf(out, "\nTRY %.*s. THE END ROOM IS %d STEP(S) AWAY.\n\n", NAME_LEN,
+    roomName(world, next), dist[room]);
+}
 
-  pthread_mutex_destroy(&mutex);
+/* ****************************************************************************
+ * Description: prints a shortest path from the start room to the end room
+ * in the same format as the path to victory
+ * @param world
+ * ***************************************************************************/
+void solve(const struct World* world) {
+  int* dist = endDistances(world);
+  int steps = dist[world->start];
+  if (steps == -1) {
+    printf("THE END ROOM CAN'T BE REACHED FROM %.*s.\n", NAME_LEN,
+      roomName(world, world->start));
+    free(dist);
+    return;
+  }
+
+  int* path = (int*) malloc(sizeof(int) * (steps + 1));
+  int room = world->start;
+  int i = 0;
+  for (; i < steps; i++) {
+    room = nextRoom(world, dist, room);
+    path[i] = room;
+  }
+  printf("THE SHORTEST PATH TAKES %d STEP(S):\n", steps);
+  printPath(stdout, world, path, steps);
+  free(path);
+  free(dist);
 }
 
 /* ****************************************************************************
- * Description: creates thread for time logging. returns 0 if error occurs 
- * while creating thread and 1 if thread is successfully handled
+ * Description: sets the clock and starts the clock thread that keeps it
  * ***************************************************************************/
-int timethread(pthread_mutex_t* mutex) {
-  pthread_t timethrd; // time thread
-  pthread_mutex_lock(mutex);  // lock thread
-  
-  // create thread for creating time file
-  int createthrd = pthread_create(&timethrd, NULL, createTimeFile, NULL);
-  if (createthrd != 0) {
+void startClock() {
+  char display[TIMEBUFFER];
+  formatTime(display);
+  setClock(display);  // set before time can be asked for
+
+  timeclock.stop = 0;
+  if (pthread_create(&timeclock.thread, NULL, clockWorker, NULL) != 0) {
     perror("error: thread could not be created\n");
-    return 0;
+    return;   // readClock() keeps time without the thread
   }
+  timeclock.running = 1;
+}
 
-  // unlock thread before returning 
-  pthread_mutex_unlock(mutex);
-  pthread_join(timethrd, NULL);   // timethrd isn't blocked by threads
-  return 1;
+/* ****************************************************************************
+ * Description: stops the clock thread and waits for it to end
+ * ***************************************************************************/
+void stopClock() {
+  if (!timeclock.running) {
+    return;
+  }
+  pthread_mutex_lock(&timeclock.mutex);
+  timeclock.stop = 1;
+  pthread_cond_signal(&timeclock.cond);
+  pthread_mutex_unlock(&timeclock.mutex);
+  pthread_join(timeclock.thread, NULL);
+  timeclock.running = 0;
+}
+
+/* ****************************************************************************
+ * Description: clock thread, refreshes the clock at the start of every
+ * second. after time is shown the time file is written here, so the game
+ * never waits on it
+ * ***************************************************************************/
+void* clockWorker(void* arg) {
+  char display[TIMEBUFFER];
+  char written[TIMEBUFFER];   // time last written to time file
+  memset(written, '\0', sizeof(written));
+
+  pthread_mutex_lock(&timeclock.mutex);
+  while (!timeclock.stop) {
+    formatTime(display);
+    setClock(display);
+    // don't hold mutex during file io
+    pthread_mutex_unlock(&timeclock.mutex);
+    flushClock(written);
+    pthread_mutex_lock(&timeclock.mutex);
+
+    // sleep until next second, or until stopped
+    struct timespec next;
+    clock_gettime(CLOCK_REALTIME, &next);
+    next.tv_sec++;
+    next.tv_nsec = 0;
+    while (!timeclock.stop &&
+        pthread_cond_timedwait(&timeclock.cond, &timeclock.mutex, &next) == 0);
+  }
+  pthread_mutex_unlock(&timeclock.mutex);
+  flushClock(written);  // time shown just before stopping
+  return NULL;
 }
 
 /* ****************************************************************************
- * Description: creates time file indicated by TIMEFILEPATH 
+ * Description: writes time of the clock to the time file if time was shown
+ * and the file doesn't hold it yet
+ * @param written time last written to time file, updated
  * ***************************************************************************/
-void* createTimeFile() {
+void flushClock(char* written) {
+  if (!__atomic_exchange_n(&timeclock.shown, 0, __ATOMIC_ACQ_REL)) {
+    return;
+  }
   char display[TIMEBUFFER];
-  memset(display, '\0', sizeof(display)); 
+  readClock(display);
+  if (strcmp(display, written) != 0) {
+    createTimeFile(display);
+    strcpy(written, display);
+  }
+}
+
+/* ****************************************************************************
+ * Description: formats current time for time command
+ * @param display TIMEBUFFER bytes
+ * ***************************************************************************/
+void formatTime(char* display) {
+  memset(display, '\0', TIMEBUFFER); 
 
   time_t curr;    // latest time
-  struct tm* tm;  // time data
+  struct tm tm;   // time data
   
   time(&curr);    // get current time
-  tm = localtime(&curr);  // get current time data
+  localtime_r(&curr, &tm);  // get current time data, thread safe
   // save time in specified format
-  strftime(display, TIMEBUFFER, "%I:%M%P, %A, %B %d, %Y", tm);
+  strftime(display, TIMEBUFFER, "%I:%M%P, %A, %B %d, %Y", &tm);
+}
+
+/* ****************************************************************************
+ * Description: writes display to the clock, only called by one thread at a
+ * time
+ * @param display
+ * ***************************************************************************/
+void setClock(const char* display) {
+  unsigned int seq = timeclock.seq;
+  __atomic_store_n(&timeclock.seq, seq + 1, __ATOMIC_RELAXED);  // odd
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  int i = 0;
+  for (; i < TIMEBUFFER; i++) {
+    __atomic_store_n(&timeclock.display[i], display[i], __ATOMIC_RELAXED);
+    if (display[i] == '\0') break;
+  }
+  __atomic_store_n(&timeclock.seq, seq + 2, __ATOMIC_RELEASE);  // even
+}
 
+/* ****************************************************************************
+ * Description: copies time of the clock to display, without locking
+ * @param display TIMEBUFFER bytes
+ * ***************************************************************************/
+void readClock(char* display) {
+  unsigned int before, after;
+  do {
+    before = __atomic_load_n(&timeclock.seq, __ATOMIC_ACQUIRE);
+    int i = 0;
+    for (; i < TIMEBUFFER; i++) {
+      display[i] = __atomic_load_n(&timeclock.display[i], __ATOMIC_RELAXED);
+      if (display[i] == '\0') break;
+    }
+    display[TIMEBUFFER - 1] = '\0';
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&timeclock.seq, __ATOMIC_RELAXED);
+  } while ((before & 1) != 0 || before != after);
+}
+
+/* ****************************************************************************
+ * Description: copies time of the clock to display for the time command,
+ * and has the clock thread write it to the time file. if the clock thread
+ * isn't running the time is found and written here instead
+ * @param display TIMEBUFFER bytes
+ * ***************************************************************************/
+void showClock(char* display) {
+  if (!timeclock.running) {
+    formatTime(display);
+    setClock(display);
+    createTimeFile(display);
+    return;
+  }
+  readClock(display);
+  __atomic_store_n(&timeclock.shown, 1, __ATOMIC_RELEASE);
+}
+
+/* ****************************************************************************
+ * Description: creates time file indicated by TIMEFILEPATH, which holds the
+ * time last shown by the clock
+ * @param display
+ * ***************************************************************************/
+void createTimeFile(const char* display) {
   // update time output file (create/overwrite)
   FILE* file = fopen(TIMEFILEPATH, "w"); 
   // check if file is accessed
   if (file == NULL) {
     perror("error: could not access file\n");
-    return NULL;
+    return;
   }
   // save content to file
   fprintf(file, "%s\n", display);
   fclose(file);
+}
 
-  return NULL;
+/* ****************************************************************************
+ * Description: plays the game with every player that connects to addr, a
+ * tcp port or a unix socket path, from one epoll loop. distances for hints
+ * are found once up front. runs until killed
+ * @param world
+ * @param addr
+ * ***************************************************************************/
+void serve(const struct World* world, const char* addr) {
+  int listener = openListener(addr);
+  int epfd = epoll_create1(0);
+  if (epfd == -1) {
+    perror("error: could not create epoll");
+    exit(1);
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;   // sessions have their Session, listener has none
+  epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+
+  signal(SIGPIPE, SIG_IGN);   // a player leaving shouldn't end the server
+  startClock();
+  // shared by all players. found before any player connects, since finding
+  // it in the loop would hold up every session
+  int* dist = endDistances(world);
+  printf("serving %s\n", addr);
+  fflush(stdout);
+
+  struct epoll_event events[MAX_EVENTS];
+  while (1) {
+    int ct = epoll_wait(epfd, events, MAX_EVENTS, -1);
+    if (ct == -1) {
+      if (errno == EINTR) continue;
+      perror("error: epoll_wait failed");
+      exit(1);
+    }
+    int i = 0;
+    for (; i < ct; i++) {
+      struct Session* session = (struct Session*) events[i].data.ptr;
+      if (session == NULL) {
+        acceptSessions(listener, epfd, world);
+        continue;
+      }
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        closeSession(session, epfd);
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        writeSession(session, epfd);
+      } else if (events[i].events & EPOLLIN) {
+        readSession(session, epfd, world, &dist);
+      }
+    }
+  }
 }
 
 /* ****************************************************************************
- * Description: reads file indicated by TIMEFILEPATH and prints content to
- * console
+ * Description: returns nonblocking socket listening on addr. addr of only
+ * digits is a tcp port, anything else a unix socket path
+ * @param addr
  * ***************************************************************************/
-void printtime() {
-  char display[TIMEBUFFER];
-  memset(display, '\0', sizeof(display));
-  FILE* file = fopen(TIMEFILEPATH, "r");
-  if (file == NULL) {
-    perror("error: could not access file\n");
+int openListener(const char* addr) {
+  int tcp = addr[0] != '\0' && strspn(addr, "0123456789") == strlen(addr);
+  int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd == -1) {
+    perror("error: could not create socket");
+    exit(1);
+  }
+
+  int res;
+  if (tcp) {
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in in;
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(INADDR_ANY);
+    in.sin_port = htons(atoi(addr));
+    res = bind(fd, (struct sockaddr*) &in, sizeof(in));
+  } else {
+    struct sockaddr_un un;
+    memset(&un, 0, sizeof(un));
+    un.sun_family = AF_UNIX;
+    if (strlen(addr) >= sizeof(un.sun_path)) {
+      fprintf(stderr, "error: socket path %s is too long\n", addr);
+      exit(1);
+    }
+    strcpy(un.sun_path, addr);
+    // a socket can be left by a server that was killed, but never remove
+    // anything else that has the name
+    struct stat old;
+    if (lstat(addr, &old) == 0) {
+      if (!S_ISSOCK(old.st_mode)) {
+        fprintf(stderr, "error: %s is in use and is not a socket\n", addr);
+        exit(1);
+      }
+      if (unlink(addr) == -1) {
+        perror("error: could not remove old socket");
+        exit(1);
+      }
+    }
+    res = bind(fd, (struct sockaddr*) &un, sizeof(un));
+  }
+  if (res == -1 || listen(fd, BACKLOG) == -1) {
+    perror("error: could not listen");
+    exit(1);
+  }
+  return fd;
+}
+
+/* ****************************************************************************
+ * Description: accepts every waiting connection and starts its game
+ * @param listener
+ * @param epfd
+ * @param world
+ * ***************************************************************************/
+void acceptSessions(int listener, int epfd, const struct World* world) {
+  int fd;
+  while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK)) != -1) {
+    struct Session* session = (struct Session*) calloc(1,
+      sizeof(struct Session));
+    if (session == NULL) {
+      close(fd);
+      continue;
+    }
+    session->fd = fd;
+    initPlayer(&session->player, world);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = session;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    // first prompt
+    FILE* out = open_memstream(&session->out, &session->outlen);
+    printPrompt(out, world, &session->player);
+    fclose(out);
+    writeSession(session, epfd);
+  }
+}
+
+/* ****************************************************************************
+ * Description: reads input of session and plays each whole word of it,
+ * keeping a word cut off at the end of the input for the next read
+ * @param session
+ * @param epfd
+ * @param world
+ * @param dist
+ * ***************************************************************************/
+void readSession(struct Session* session, int epfd,
+    const struct World* world, int** dist) {
+  ssize_t len = recv(session->fd, session->in + session->inlen,
+    SESSION_IN - session->inlen, 0);
+  if (len == -1 && (errno == EAGAIN || errno == EINTR)) {
     return;
   }
+  if (len <= 0) {
+    closeSession(session, epfd);  // player left
+    return;
+  }
+  size_t old = session->inlen;
+  session->inlen += len;
+  if (session->skip) {
+    size_t end = old;
+    while (end < session->inlen && !isspace((unsigned char) session->in[end])) {
+      end++;
+    }
+    session->skip = end == session->inlen;
+    memmove(session->in + old, session->in + end, session->inlen - end);
+    session->inlen -= end - old;
+  }
 
-  if (fgets(display, TIMEBUFFER, file) != NULL) {
-    printf("\n%s\n", display);
+  // output is added after output not yet sent
+  char* buf = NULL;
+  size_t buflen = 0;
+  FILE* out = open_memstream(&buf, &buflen);
+  if (session->outsent < session->outlen) {
+    fwrite(session->out + session->outsent, 1,
+      session->outlen - session->outsent, out);
   }
 
-  fclose(file);
+  size_t start = 0;
+  size_t i = 0;
+  for (; i < session->inlen && !session->done; i++) {
+    if (!isspace((unsigned char) session->in[i])) continue;
+    if (i > start) {
+      // words are cut to their first BUFFER - 1 chars
+      char input[BUFFER];
+      size_t wordlen = i - start < BUFFER - 1 ? i - start : BUFFER - 1;
+      memcpy(input, session->in + start, wordlen);
+      input[wordlen] = '\0';
+      session->done = playInput(out, world, &session->player, dist, input);
+    }
+    start = i + 1;
+  }
+  // a word cut off at the end keeps only its first BUFFER - 1 chars, the
+  // rest is dropped as it comes in and the word is played at its space
+  if (session->inlen - start > BUFFER - 1) {
+    session->inlen = start + BUFFER - 1;
+    session->skip = 1;
+  }
+  memmove(session->in, session->in + start, session->inlen - start);
+  session->inlen -= start;
+
+  fclose(out);
+  free(session->out);
+  session->out = buf;
+  session->outlen = buflen;
+  session->outsent = 0;
+  writeSession(session, epfd);
+}
+
+/* ****************************************************************************
+ * Description: sends output of session the socket takes now. waits for the
+ * socket to take the rest, if any, instead of reading more input. closes
+ * session once its game is over and all output is sent
+ * @param session
+ * @param epfd
+ * ***************************************************************************/
+void writeSession(struct Session* session, int epfd) {
+  while (session->outsent < session->outlen) {
+    ssize_t len = send(session->fd, session->out + session->outsent,
+      session->outlen - session->outsent, MSG_NOSIGNAL);
+    if (len == -1) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN) {
+        closeSession(session, epfd);
+        return;
+      }
+      struct epoll_event ev;
+      ev.events = EPOLLOUT;
+      ev.data.ptr = session;
+      epoll_ctl(epfd, EPOLL_CTL_MOD, session->fd, &ev);
+      return;
+    }
+    session->outsent += len;
+  }
+
+  if (session->done) {
+    closeSession(session, epfd);
+    return;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = session;
+  epoll_ctl(epfd, EPOLL_CTL_MOD, session->fd, &ev);
+}
+
+/* ****************************************************************************
+ * Description: ends session of a player
+ * @param session
+ * @param epfd
+ * ***************************************************************************/
+void closeSession(struct Session* session, int epfd) {
+  epoll_ctl(epfd, EPOLL_CTL_DEL, session->fd, NULL);
+  close(session->fd);
+  free(session->player.path);
+  free(session->out);
+  free(session);
 }
+
 /* ****************************************************************************
  * Description: returns array of the randomly-selected rooms
  * @param n: number of rooms to create
  * ***************************************************************************/
-int main() {
+int main(int argc, char** argv) {
+  int solving = argc > 1 && strcmp(argv[1], "solve") == 0;
+  int batch = argc > 1 && strcmp(argv[1], "batch") == 0;
+  int serving = argc > 1 && strcmp(argv[1], "serve") == 0;
+  if (argc > 1 && !batch && !(solving && argc == 2) &&
+      !(serving && argc == 3)) {
+    fprintf(stderr, "usage: %s [solve | batch [room directory ...] | "
+      "serve <port | socket path>]\n", argv[0]);
+    exit(1);
+  }
+
   // set up room file search
   char targetdir[BUFFER];
   sprintf(targetdir, "%s", DIRPREFIX);
   memset(targetdir, '\0', sizeof(targetdir));
   strcpy(targetdir, DIRPREFIX);
-
-  // retrieve room info
-  struct Room* rooms = getRooms(targetdir, NUM_ROOMS);
-  struct Room* startroom = getStartRoom(rooms, NUM_ROOMS);
-  if (startroom == NULL) {
-    perror("error: could not set start room. Proceeding to exit\n");
-    exit(101);
+  char location[BUFFER];
+  struct World world;
+
+  // print fewest steps of each room directory
+  if (batch && argc > 2) {
+    int i = 2;
+    for (; i < argc; i++) {
+      loadWorld(&world, argv[i]);
+      int* dist = endDistances(&world);
+      printf("%s\t%d\n", argv[i], dist[world.start]);
+      free(dist);
+      freeWorld(&world);
+    }
+    return 0;
   }
+
+  // retrieve room info of latest room directory
+  getRoomDir(location, targetdir);
+  loadWorld(&world, location);
   
-  // start game
-  startGame(rooms, NUM_ROOMS, startroom);
+  if (batch) {
+    int* dist = endDistances(&world);
+    printf("%s\t%d\n", location, dist[world.start]);
+    free(dist);
+  } else if (solving) {
+    solve(&world);
+  } else if (serving) {
+    serve(&world, argv[2]);
+  } else {
+    // start game
+    startGame(&world);
+  }
 
   // free room memory
-  free(rooms);
+  freeWorld(&world);
   return 0;
 }
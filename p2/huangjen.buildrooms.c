@@ -1,10 +1,22 @@
 /* ****************************************************************************
  * Author:  Jenny Huang
  * Date:    October 19, 2019
- * Description: generates 7 different room files which contains one room per 
- * file. These files are created in a directory called 
- * huangjen.rooms.<PROCESS_ID_OF_ROOM_PROGRAM>
+ * Description: generates a world of rooms, 7 by default, with one room file
+ * per room and a binary world file holding all of them. These files are
+ * created in a directory called huangjen.rooms.<PROCESS_ID_OF_ROOM_PROGRAM>
+ *
+ * usage: huangjen.buildrooms [-s] [number of rooms] [seed]
+ * -s syncs the rooms to disk before exiting
+ * any number of rooms from MIN_CONN + 1 up to millions may be made. up to
+ * MAX_ROOMS rooms are named from ROOM_NAMES, more get made up 8 letter names.
+ * connections are made by pairing shuffled stubs, one for each connection a
+ * room is given, which takes O(n) time
+ *
+ * the world file format is in huangjen.world.h. LATESTLINK is pointed at
+ * the new directory once it's complete.
+ * room files of large worlds are formatted and written by several threads
  * ***************************************************************************/
+#define _GNU_SOURCE // syncfs
 #include <stdio.h>
 #include <sys/stat.h> // mkdir
 #include <unistd.h>
@@ -12,14 +24,25 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <time.h> 
+#include <fcntl.h>
+#include <pthread.h>
+#include "huangjen.world.h"
 
 #define DIRPREFIX "./huangjen.rooms."
 #define BUFFER 32 
-#define NAME_LEN 8
-#define NUM_ROOMS 7 // number of rooms to create
+#define NAME_LEN WORLD_NAME_LEN // max 8 + \0
+#define NUM_ROOMS 7 // default number of rooms to create
 #define MAX_ROOMS 10  // maximum number of room names to select from
 #define MIN_CONN 3 // min outbound connections
 #define MAX_CONN 6 // max outbound connections
+#define MAX_TRIES 32 // random picks for a connection before searching
+#define LETTERS 26
+#define NAME_SPACE 208827064576LL // 26^8, number of made up names
+#define NAME_STEP 2750159LL // coprime to 26, spreads made up names
+#define ROOM_FILE_MAX 256 // longest room file
+#define WRITE_BATCH 4096  // rooms formatted before their files are written
+#define WRITE_THREADS 8 // most threads writing room files
+#define WRITE_PARALLEL 16384  // rooms before room files are written by threads
 
 const char* ROOM_NAMES[MAX_ROOMS] = { 
   "squelchr", 
@@ -41,54 +64,68 @@ enum room_type {
 
 /* ****************************************************************************
  * Description: struct to represent a single instance of a room
- * note: name and connections are represented as integer indexes for char vals
- * given by ROOM_SELECTION
+ * note: connections are represented as integer indexes of rooms
  * ***************************************************************************/
 struct Room {
-  int name;
-  int outbounds[MAX_CONN];  // names of outbound connections
+  char name[NAME_LEN];
+  int outbounds[MAX_CONN];  // rooms of outbound connections
   int n_conn; // number of outbound connections
   enum room_type type;
 };
 
+/* ****************************************************************************
+ * Description: rooms from first up to last, written by one thread
+ * ***************************************************************************/
+struct Writer {
+  const struct Room* rooms;
+  int first;
+  int last;
+  int dirfd;  // room directory
+};
+
 // function declarations
 struct Room* initRooms(int);
+void nameRooms(struct Room*, int);
+void makeName(char*, long long);
 void setRoomType(struct Room*, int);
 void makeConnections(struct Room*, int);
-int contains(int*, int, int);
+void connectRooms(struct Room*, int, int);
+int canConnect(const struct Room*, int, int);
+int findPartner(const struct Room*, int, int);
+int contains(const int*, int, int);
 char* typeStr(enum room_type);
 void printRooms(const struct Room*, int); // for debugging
 
 void createDirectory(char*);
-void createRoomFiles(const struct Room*, int, const char*); 
+void createRoomFiles(const struct Room*, int, const char*, int); 
+void* writeRoomFiles(void*);
+int formatRoom(char*, const struct Room*, int);
+void createWorldFile(const struct Room*, int, const char*);
+void updateLatest(const char*);
 
 /* ****************************************************************************
  * Description: creates the rooms and initializes values
  * @param n: number of rooms
  * ***************************************************************************/
 struct Room* initRooms(int n) {
-  int selected[MAX_ROOMS] = { 0 };  // for tracking taken names 
-
   // create array of rooms
   struct Room* rooms = (struct Room*) malloc(sizeof(struct Room) * n);
+  if (rooms == NULL) {
+    perror("error: could not allocate rooms");
+    exit(1);
+  }
 
   int i;
   for (i = 0; i < n; i++) {
-    // determine and assign room name
-    int temp; // name for room
-    do {  // keep selecting random name if name has been taken
-      temp = rand() % MAX_ROOMS;
-    } while (selected[temp] != 0);
-    selected[temp] = 1;
-    rooms[i].name = temp;   // assign name to room once determined 
-    
-    // printf("initRooms: rooms[i].name = %d\n", rooms[i].name);
     // initialize connections for each room
     rooms[i].n_conn = 0;
     // initialize room_type to MID, by default
     rooms[i].type = MID_ROOM;
   }
 
+  // determine and assign room names
+  nameRooms(rooms, n);
+
   // set up start and end rooms
   setRoomType(rooms, n);
 
@@ -99,6 +136,50 @@ struct Room* initRooms(int n) {
   return rooms;
 }
 
+/* ****************************************************************************
+ * Description: gives every room a different name. up to MAX_ROOMS rooms get
+ * randomly selected names of ROOM_NAMES, more rooms get made up names
+ * @param rooms: array of rooms
+ * @param n: number of rooms
+ * ***************************************************************************/
+void nameRooms(struct Room* rooms, int n) {
+  int i;
+  if (n > MAX_ROOMS) {
+    // start at a random name, every step gives a name not used yet
+    long long id = ((long long) rand() * RAND_MAX + rand()) % NAME_SPACE;
+    for (i = 0; i < n; i++) {
+      makeName(rooms[i].name, id);
+      id = (id + NAME_STEP) % NAME_SPACE;
+    }
+    return;
+  }
+
+  int selected[MAX_ROOMS] = { 0 };  // for tracking taken names 
+  for (i = 0; i < n; i++) {
+    int temp; // name for room
+    do {  // keep selecting random name if name has been taken
+      temp = rand() % MAX_ROOMS;
+    } while (selected[temp] != 0);
+    selected[temp] = 1;
+    strcpy(rooms[i].name, ROOM_NAMES[temp]);
+  }
+}
+
+/* ****************************************************************************
+ * Description: writes the 8 letter name numbered id to name, different ids
+ * below NAME_SPACE give different names
+ * @param name
+ * @param id
+ * ***************************************************************************/
+void makeName(char* name, long long id) {
+  int i;
+  for (i = NAME_LEN - 2; i >= 0; i--) {
+    name[i] = 'a' + id % LETTERS;
+    id /= LETTERS;
+  }
+  name[NAME_LEN - 1] = '\0';
+}
+
 /* ****************************************************************************
  * Description: selects the START and END rooms
  * @param rooms: array of rooms
@@ -106,11 +187,11 @@ struct Room* initRooms(int n) {
  * ***************************************************************************/
 void setRoomType(struct Room* rooms, int n) {
   // determine start and end rooms
-  int start = rand() % NUM_ROOMS;
+  int start = rand() % n;
   int end;
   // if same room for start is selected for end, keep randomly selecting
   do {
-    end = rand() % NUM_ROOMS;
+    end = rand() % n;
   } while (start == end);
 
   // start and end rooms have been determined. Assign them to the rooms
@@ -121,40 +202,110 @@ void setRoomType(struct Room* rooms, int n) {
 }
 
 /* ****************************************************************************
- * Description: makes connections between rooms
+ * Description: makes connections between rooms. each room is given a number
+ * of connections between MIN_CONN and MAX_CONN and a stub for each. the
+ * stubs are shuffled and paired off, pairs that would connect a room to
+ * itself or connect two rooms twice are dropped. rooms left with fewer than
+ * MIN_CONN connections are then connected to random rooms with room to spare
  * @param rooms: array of rooms
  * @param n: number of rooms
  * ***************************************************************************/
 void makeConnections(struct Room* rooms, int n) {
-  int i = 0;
+  int* stubs = (int*) malloc(sizeof(int) * n * MAX_CONN);
+  if (stubs == NULL) {
+    perror("error: could not allocate connections");
+    exit(1);
+  }
+
+  // a stub for every connection each room is to get
+  int n_stubs = 0;
+  int i, j;
   for (i = 0; i < n; i++) {
-    struct Room* room = &rooms[i];    // current room 
-
-    struct Room* sele;                // room to connect with curr
-
-    // add connections if minimum number of connections hasnt been reached
-    while (room->n_conn < MIN_CONN) {
-      int sel;  // room to connect
-
-      // continue to select another connection if current selection is itself
-      // or if the room selected has reached its max num of connections
-      // or if there already exists a connection with the selected room
-      do {
-        sel = rand() % n;     // index of random room to connect
-        sele = &rooms[sel];   // get reference to selected room
-      } while (sel == i || sele->n_conn > MAX_CONN ||
-        contains(room->outbounds, room->n_conn, sele->name) != 0);
-      
-      // make connection between the two rooms
-      // add connection from this room to selected room
-      room->outbounds[room->n_conn++] = sele->name; 
-      // add connection from selected room to curr room
-      sele->outbounds[sele->n_conn++] = room->name;
+    int degree = MIN_CONN + rand() % (MAX_CONN - MIN_CONN + 1);
+    for (j = 0; j < degree; j++) {
+      stubs[n_stubs++] = i;
     }
   }
-  return;
+
+  // shuffle stubs (fisher-yates)
+  for (i = n_stubs - 1; i > 0; i--) {
+    j = rand() % (i + 1);
+    int temp = stubs[i];
+    stubs[i] = stubs[j];
+    stubs[j] = temp;
+  }
+
+  // connect rooms of each pair of stubs
+  for (i = 0; i + 1 < n_stubs; i += 2) {
+    if (canConnect(rooms, stubs[i], stubs[i + 1])) {
+      connectRooms(rooms, stubs[i], stubs[i + 1]);
+    }
+  }
+  free(stubs);
+
+  // add connections if minimum number of connections hasnt been reached
+  for (i = 0; i < n; i++) {
+    while (rooms[i].n_conn < MIN_CONN) {
+      int sel = findPartner(rooms, n, i);
+      if (sel == -1) {
+        fprintf(stderr, "warning: %s has %d connections\n", rooms[i].name,
+          rooms[i].n_conn);
+        break;
+      }
+      connectRooms(rooms, i, sel);
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description: makes connection between two rooms, both ways
+ * @param rooms
+ * @param a
+ * @param b
+ * ***************************************************************************/
+void connectRooms(struct Room* rooms, int a, int b) {
+  rooms[a].outbounds[rooms[a].n_conn++] = b;
+  rooms[b].outbounds[rooms[b].n_conn++] = a;
 }
 
+/* ****************************************************************************
+ * Description: returns 1 if rooms a and b can be connected: they're not the
+ * same room or already connected, and both have room for a connection
+ * @param rooms
+ * @param a
+ * @param b
+ * ***************************************************************************/
+int canConnect(const struct Room* rooms, int a, int b) {
+  return a != b && rooms[a].n_conn < MAX_CONN && rooms[b].n_conn < MAX_CONN &&
+    contains(rooms[a].outbounds, rooms[a].n_conn, b) == 0;
+}
+
+/* ****************************************************************************
+ * Description: returns a room that room i can be connected to, or -1 if none
+ * can. random rooms are tried first, then every room from a random one on
+ * @param rooms
+ * @param n: number of rooms
+ * @param i
+ * ***************************************************************************/
+int findPartner(const struct Room* rooms, int n, int i) {
+  int tries;
+  for (tries = 0; tries < MAX_TRIES; tries++) {
+    int sel = rand() % n;
+    if (canConnect(rooms, i, sel)) {
+      return sel;
+    }
+  }
+
+  int start = rand() % n;
+  int k;
+  for (k = 0; k < n; k++) {
+    int sel = (start + k) % n;
+    if (canConnect(rooms, i, sel)) {
+      return sel;
+    }
+  }
+  return -1;
+}
 
 /* ****************************************************************************
  * Description: returns 1 if array contains value and 0 otherwise
@@ -162,7 +313,7 @@ void makeConnections(struct Room* rooms, int n) {
  * @param n
  * @param val
  * ***************************************************************************/
-int contains(int* arr, int n, int val) {
+int contains(const int* arr, int n, int val) {
   int i;
   for (i = 0; i < n; i++) {
     if (arr[i] == val) {
@@ -186,41 +337,214 @@ void createDirectory(char* dir) {
 }
 
 /* ****************************************************************************
- * Description: creates files for each room in a specified directory 
+ * Description: creates files for each room in a specified directory. the
+ * rooms are split between threads for large worlds. if sync is set, all
+ * files are synced to disk at once at the end
  * @param rooms
  * @param n
  * @param dir
+ * @param sync
  * ***************************************************************************/
-void createRoomFiles(const struct Room* rooms, int n, const char* dir) {
-  if (chdir(dir) != 0) {
+void createRoomFiles(const struct Room* rooms, int n, const char* dir,
+    int sync) {
+  int dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+  if (dirfd == -1) {
     printf("error: could not access %s\n", dir);
     return;
   }
 
-  FILE* file;
+  // use threads only when there are enough rooms to pay for them
+  int nthreads = 1;
+  if (n >= WRITE_PARALLEL) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = cpus < 1 ? 1 : cpus > WRITE_THREADS ? WRITE_THREADS : cpus;
+  }
 
+  pthread_t threads[WRITE_THREADS];
+  struct Writer writers[WRITE_THREADS];
   int i;
-  for (i = 0; i < n; i++) {
-    const struct Room* room = &rooms[i];
-    const char* filename = ROOM_NAMES[room->name];
+  for (i = 0; i < nthreads; i++) {
+    writers[i].rooms = rooms;
+    writers[i].first = (int) ((long long) n * i / nthreads);
+    writers[i].last = (int) ((long long) n * (i + 1) / nthreads);
+    writers[i].dirfd = dirfd;
+  }
+  // this thread writes the first rooms
+  for (i = 1; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, writeRoomFiles, &writers[i]) != 0) {
+      perror("error: thread could not be created");
+      exit(1);
+    }
+  }
+  writeRoomFiles(&writers[0]);
+  for (i = 1; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // one sync for every file instead of one per file
+  if (sync && (syncfs(dirfd) != 0 || fsync(dirfd) != 0)) {
+    perror("error: could not sync room files");
+    exit(1);
+  }
+  close(dirfd);
+}
+
+/* ****************************************************************************
+ * Description: writes room files of one Writer. rooms are formatted
+ * WRITE_BATCH at a time into one buffer, then each file is written from it
+ * with a single write()
+ * @param arg Writer
+ * ***************************************************************************/
+void* writeRoomFiles(void* arg) {
+  const struct Writer* writer = (const struct Writer*) arg;
+  char* buf = (char*) malloc(WRITE_BATCH * ROOM_FILE_MAX);
+  int* ends = (int*) malloc(sizeof(int) * WRITE_BATCH);  // end of each room
+  if (buf == NULL || ends == NULL) {
+    perror("error: could not allocate room files");
+    exit(1);
+  }
 
-    file = fopen(filename, "w");    // create file with write permissions
+  int first = writer->first;
+  while (first < writer->last) {
+    // format batch
+    int ct = writer->last - first;
+    if (ct > WRITE_BATCH) ct = WRITE_BATCH;
+    int len = 0;
+    int i;
+    for (i = 0; i < ct; i++) {
+      len += formatRoom(buf + len, writer->rooms, first + i);
+      ends[i] = len;
+    }
 
-    // write room name to file
-    fprintf(file, "ROOM NAME: %s\n", ROOM_NAMES[room->name]);
-    
-    // write connections to file
+    // write batch
+    int start = 0;
+    for (i = 0; i < ct; i++) {
+      const char* filename = writer->rooms[first + i].name;
+      int fd = openat(writer->dirfd, filename, O_WRONLY | O_CREAT | O_TRUNC,
+        0644);
+      if (fd == -1 || write(fd, buf + start, ends[i] - start) !=
+          ends[i] - start || close(fd) != 0) {
+        perror("error: could not create room file");
+        exit(1);
+      }
+      start = ends[i];
+    }
+    first += ct;
+  }
+
+  free(buf);
+  free(ends);
+  return NULL;
+}
+
+/* ****************************************************************************
+ * Description: formats room file of room i into buf, which has space for
+ * ROOM_FILE_MAX bytes. returns length of room file
+ * @param buf
+ * @param rooms
+ * @param i
+ * ***************************************************************************/
+int formatRoom(char* buf, const struct Room* rooms, int i) {
+  const struct Room* room = &rooms[i];
+
+  // write room name to file
+  int len = sprintf(buf, "ROOM NAME: %s\n", room->name);
+
+  // write connections to file
+  int j;
+  for (j = 0; j < room->n_conn; j++) {
+    len += sprintf(buf + len, "CONNECTION %d: %s\n", j + 1, 
+      rooms[room->outbounds[j]].name);
+  }
+
+  // write room type to file
+  len += sprintf(buf + len, "ROOM TYPE: %s\n\n", typeStr(room->type));
+  return len;
+}
+
+/* ****************************************************************************
+ * Description: writes rooms to the world file of directory dir, in the
+ * format described in huangjen.world.h. the file is written under a
+ * temporary name and renamed, so it's never seen half written
+ * @param rooms
+ * @param n
+ * @param dir
+ * ***************************************************************************/
+void createWorldFile(const struct Room* rooms, int n, const char* dir) {
+  char path[BUFFER * 2];
+  char tmppath[BUFFER * 3];
+  sprintf(path, "%s/%s", dir, WORLDFILE);
+  sprintf(tmppath, "%s.tmp", path);
+
+  // lay out sections
+  struct WorldHeader header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, WORLDMAGIC);
+  header.version = WORLDVERSION;
+  header.byteorder = WORLDBYTEORDER;
+  header.n = n;
+  header.namelen = NAME_LEN;
+  int i;
+  for (i = 0; i < n; i++) {
+    header.m += rooms[i].n_conn;
+    if (rooms[i].type == START_ROOM) header.start = i;
+    if (rooms[i].type == END_ROOM) header.end = i;
+  }
+  header.names = WORLDALIGN(sizeof(header));
+  header.offsets = WORLDALIGN(header.names + (uint64_t) n * NAME_LEN);
+  header.targets = WORLDALIGN(header.offsets + (uint64_t) (n + 1) * 4);
+  header.types = WORLDALIGN(header.targets + header.m * 4);
+  header.size = header.types + n;
+
+  // build file in memory and write it at once
+  char* buf = (char*) calloc(1, header.size);
+  if (buf == NULL) {
+    perror("error: could not allocate world file");
+    exit(1);
+  }
+  memcpy(buf, &header, sizeof(header));
+  uint32_t* offsets = (uint32_t*) (buf + header.offsets);
+  uint32_t* targets = (uint32_t*) (buf + header.targets);
+  uint32_t m = 0;
+  for (i = 0; i < n; i++) {
+    memcpy(buf + header.names + (uint64_t) i * NAME_LEN, rooms[i].name,
+      NAME_LEN);
+    offsets[i] = m;
     int j;
-    for (j = 0; j < room->n_conn; j++) {
-      fprintf(file, "CONNECTION %d: %s\n", j + 1, 
-        ROOM_NAMES[room->outbounds[j]]);
+    for (j = 0; j < rooms[i].n_conn; j++) {
+      targets[m++] = rooms[i].outbounds[j];
     }
-    
-    // write room type to file
-    fprintf(file, "ROOM TYPE: %s\n\n", typeStr(room->type));
+    buf[header.types + i] = rooms[i].type;
   }
+  offsets[n] = m;
 
-  fclose(file);
+  FILE* file = fopen(tmppath, "w");
+  if (file == NULL || fwrite(buf, 1, header.size, file) != header.size ||
+      fclose(file) != 0 || rename(tmppath, path) != 0) {
+    perror("error: could not create world file");
+    exit(1);
+  }
+  free(buf);
+}
+
+/* ****************************************************************************
+ * Description: points LATESTLINK at directory dir. the link is made under a
+ * temporary name and renamed over the old one, so adventure always finds
+ * either the old or the new directory. adventure falls back to searching
+ * for the latest directory if this fails, so it's not an error
+ * @param dir
+ * ***************************************************************************/
+void updateLatest(const char* dir) {
+  const char* name = strrchr(dir, '/');   // link is relative to its directory
+  name = (name == NULL) ? dir : name + 1;
+
+  char tmplink[BUFFER * 2];
+  sprintf(tmplink, ".%s.%d", LATESTLINK, getpid());
+  unlink(tmplink);
+  if (symlink(name, tmplink) != 0 || rename(tmplink, LATESTLINK) != 0) {
+    perror("warning: could not update " LATESTLINK);
+    unlink(tmplink);
+  }
 }
 
 /* ****************************************************************************
@@ -233,12 +557,12 @@ void printRooms(const struct Room* rooms, int n) {
   for (i = 0; i < n; i++) {
     const struct Room* room = &rooms[i];
     // print room name
-    printf("ROOM NAME: %s\n", ROOM_NAMES[room->name]);
+    printf("ROOM NAME: %s\n", room->name);
     
     // print connections
     int j;
     for (j = 0; j < room->n_conn; j++) {
-      printf("CONNECTION %d: %s\n", j + 1, ROOM_NAMES[room->outbounds[j]]);
+      printf("CONNECTION %d: %s\n", j + 1, rooms[room->outbounds[j]].name);
     }
     
     // print room type
@@ -267,15 +591,38 @@ char* typeStr(enum room_type type) {
 /* ****************************************************************************
  * MAIN FUNCTION
  * ***************************************************************************/
-int main() {
-  srand(time(0));   // use current time to seed for random generator
-  struct Room* rooms = initRooms(NUM_ROOMS);
-  // printRooms(rooms, NUM_ROOMS);  // debugging
+int main(int argc, char** argv) {
+  // get sync option, number of rooms and seed
+  int sync = 0;
+  int arg = 1;
+  if (argc > arg && strcmp(argv[arg], "-s") == 0) {
+    sync = 1;
+    arg++;
+  }
+  int n = NUM_ROOMS;
+  unsigned int seed = time(0);  // use current time to seed by default
+  if (argc > arg) {
+    n = atoi(argv[arg]);
+  }
+  if (argc > arg + 1) {
+    seed = strtoul(argv[arg + 1], NULL, 10);
+  }
+  if (n < MIN_CONN + 1 || argc > arg + 2) {
+    fprintf(stderr, "usage: %s [-s] [number of rooms, at least %d] [seed]\n",
+      argv[0], MIN_CONN + 1);
+    exit(1);
+  }
+
+  srand(seed);   // seed for random generator
+  struct Room* rooms = initRooms(n);
+  // printRooms(rooms, n);  // debugging
 
   // create directory for rooms
   char dir[BUFFER];
   createDirectory(dir);
-  createRoomFiles(rooms, NUM_ROOMS, dir);
+  createWorldFile(rooms, n, dir);
+  createRoomFiles(rooms, n, dir, sync);
+  updateLatest(dir);
 
   //free rooms
   free(rooms);
@@ -0,0 +1,46 @@
+/* ****************************************************************************
+ * Author:  Jenny Huang
+ * Date:    October 19, 2019
+ * Description: format of the world file buildrooms writes next to the room
+ * files, which adventure maps into memory instead of reading the room files.
+ * the file is a header followed by these sections, each starting on an
+ * 8 byte boundary:
+ *    names:    n names of WORLD_NAME_LEN bytes, \0 padded
+ *    offsets:  n + 1 uint32_t, connections of room i are
+ *              targets[offsets[i]] up to targets[offsets[i + 1]]
+ *    targets:  m uint32_t, index of connected room
+ *    types:    n uint8_t, room type (START_ROOM, MID_ROOM, END_ROOM)
+ * numbers are in the byte order of the machine that wrote the file
+ * ***************************************************************************/
+#ifndef HUANGJEN_WORLD_H
+#define HUANGJEN_WORLD_H
+
+#include <stdint.h>
+
+#define WORLDFILE ".world"  // in room directory, . keeps it from room files
+#define WORLDMAGIC "HJWORLD"
+#define WORLDVERSION 1
+#define WORLDBYTEORDER 0x01020304
+#define WORLD_NAME_LEN 9  // max 8 + \0
+#define WORLDALIGN(x) (((x) + 7) & ~(uint64_t) 7)
+
+// symlink to the latest room directory, replaced with rename() by buildrooms
+#define LATESTLINK "huangjen.rooms.latest"
+
+struct WorldHeader {
+  char magic[8];        // WORLDMAGIC
+  uint32_t version;     // WORLDVERSION
+  uint32_t byteorder;   // WORLDBYTEORDER as written
+  uint32_t n;           // number of rooms
+  uint32_t start;       // index of start room
+  uint32_t end;         // index of end room
+  uint32_t namelen;     // bytes per name, WORLD_NAME_LEN
+  uint64_t m;           // number of connections of all rooms
+  uint64_t names;       // file offset of each section
+  uint64_t offsets;
+  uint64_t targets;
+  uint64_t types;
+  uint64_t size;        // size of file
+};
+
+#endif
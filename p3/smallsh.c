@@ -3,7 +3,8 @@
  * Date:    November 4, 2019
  * Description:  
  * Program that supports three built-in commands: exit, cd, and status
- * Input/output redirection is not supported for these built in commands
+ * builtins are found in a table and run in the shell, with > and < handled
+ * without forking
  *
  * exit: exits shell and kills any other processes or jobs that the shell has
  * has started before termination
@@ -16,7 +17,48 @@
  *
  * status: prints out the exit status or terminating signal of the last 
  * foreground process
+ *
+ * jobs: lists background jobs and whether they're running, stopped or done
+ *
+ * wait: waits for the given jobs (%id or pid), or all jobs, to finish
+ *
+ * fg, bg: continues a job (%id or pid, most recent if not given) in the
+ * foreground or in the background
+ *
+ * parallel: runs the command lines of a file (an argument or given with <),
+ * or of stdin until EOF, with at most N (-j N, number of cpus by default)
+ * running at once. each command line's output is held until it's done so
+ * outputs don't mix, and a summary of every command line's status is printed
+ * at the end
+ *
+ * time: prefixing a command line with time reports the wall, user and system
+ * time it took, the largest max RSS of its commands, and their context
+ * switches and page faults once it's done
+ *
+ * bgnice, bgcpus, bgulimit, bgcgroup: set the niceness, the cpus, ulimit
+ * style resource limits and the cgroup (v2) of commands run in the
+ * background with &. with no arguments they print what's set
+ *
+ * echo, pwd, true, false, test, [, printf, kill: run in the shell instead of
+ * being launched, unless they're part of a pipeline or run with &
+ *
+ * hash: lists the remembered locations of commands. hash -r forgets them,
+ * hash name... looks up and remembers the named commands
+ *
+ * commands may be joined into a pipeline with |, every command of it runs at
+ * the same time with its output piped to the next. < and > redirections
+ * still apply to each command. status reports the last command of a pipeline
+ *
+ * smallsh file runs the commands of file and smallsh -c cmds runs cmds, with
+ * no prompt. input that isn't a terminal is read in large blocks and the
+ * shell exits at its end with the status of the last command
+ *
+ * other commands are launched with posix_spawn(), which doesn't copy the
+ * shell's page tables. fork() and execvp() are used if spawning fails or if
+ * SMALLSH_LAUNCH=fork is set in the environment. the PATH lookup of a
+ * command is remembered until PATH changes or the remembered file fails
  * ***************************************************************************/
+#define _GNU_SOURCE   // pipe2
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -25,9 +67,16 @@
 #include <ctype.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <sched.h>
 
 #define BUFFER 2048
-#define ARGBUFF 512 
 
 #define STKMAX 512
 
@@ -38,6 +87,45 @@
 #define EXIT "exit"
 #define CD "cd"
 #define STATUS "status"
+#define HASH "hash"
+#define JOBS "jobs"
+#define WAIT "wait"
+#define FG "fg"
+#define BG "bg"
+#define PARALLEL "parallel"
+#define TIME "time"
+#define BGNICE "bgnice"
+#define BGCPUS "bgcpus"
+#define BGULIMIT "bgulimit"
+#define BGCGROUP "bgcgroup"
+#define UNLIMITED "unlimited"
+#define ECHO "echo"
+#define PWD "pwd"
+#define TRUE "true"
+#define FALSE "false"
+#define TEST "test"
+#define BRACKET "["
+#define PRINTF "printf"
+#define KILL "kill"
+#define CGROUP_PROCS "cgroup.procs"
+#define PATH "PATH"
+#define DEFPATH "/bin:/usr/bin"  // search path execvp() uses if PATH is unset
+#define TMPDIR "TMPDIR"
+#define DEFTMP "/tmp"   // directory for temporary files if TMPDIR is unset
+#define DEVNULL "/dev/null"
+
+// environment variable selecting the launch path
+#define LAUNCH_ENV "SMALLSH_LAUNCH"
+#define LAUNCH_FORK "fork"
+
+#define HASHSIZE 64  // initial number of slots in command hash
+#define ARENASIZE 65536 // bytes in a command line arena block
+#define PIDVAR "$$"
+#define PIPE "|"
+#define MAX_JOBS 64
+#define INPUTSIZE 65536 // bytes read at once from input that isn't a tty
+#define BUILTINSIZE 32  // smallest builtin table
+#define BUILTINMAX 4096 // largest builtin table tried for a perfect hash
 
 /* ****************************************************************************
  * struct/enum definitions
@@ -47,12 +135,140 @@ enum _bool {
   _false
 };
 
+// block of memory handed out by an arena
+struct arenablock {
+  struct arenablock* next;
+  size_t size;  // bytes in data
+  size_t used;  // bytes handed out
+  char data[];
+};
+
+// bump allocator for everything a command line needs, reset after the
+// command has run instead of freeing each piece
+struct arena {
+  struct arenablock* head;
+};
+
+// a single command of a command line, pipelines have several
+struct command {
+  char** args;    // NULL terminated
+  int n;          // number of args
+  char* infile;   // NULL if input isn't redirected
+  char* outfile;  // NULL if output isn't redirected
+};
+
+// state of a job
+enum jobstate {
+  RUNNING,
+  STOPPED,
+  DONE
+};
+
+// a background command line, or a foreground one that was stopped
+struct job {
+  int id;         // 0 if slot is unused
+  pid_t* pids;    // pid of each command, 0 once it has been reaped
+  pid_t last;     // pid of last command
+  int n;          // number of commands
+  int live;       // number of commands not yet reaped
+  int status;     // status of last command
+  enum jobstate state;
+  enum jobstate shown;  // state last reported to the user
+  char* cmdline;
+  enum _bool timed;       // report usage once done
+  struct timespec start;  // when job was launched
+  struct timespec end;    // when its last command was reaped
+  struct rusage usage;    // usage of commands reaped so far
+};
+
+// a command line run by parallel
+struct task {
+  char* cmdline;          // line as read, for the summary
+  struct command* cmds;   // NULL if line couldn't be parsed
+  int n;                  // number of commands
+  pid_t* pids;            // pid of each command, 0 once it has been reaped
+  int live;               // number of commands not yet reaped
+  int out;                // file holding output of the command line
+  int status;             // status of last command
+};
+
+// resource controls applied to commands run in the background
+struct limits {
+  enum _bool set;       // any control is set
+  int nice;             // added to niceness, 0 to keep shell's
+  enum _bool pinned;    // run only on cpus
+  cpu_set_t cpus;
+  char* cpulist;        // cpus as given
+  int rlimset;          // bit for each resource in rlim that is set
+  struct rlimit rlim[RLIMIT_NLIMITS];
+  char* cgroup;         // cgroup directory, NULL to keep shell's
+};
+
+// resource limit settable with bgulimit
+struct rlimitopt {
+  char opt;       // option letter, as ulimit takes it
+  int resource;
+  int unit;       // bytes or seconds per unit of value
+  const char* name;
+};
+
+// command run by the shell itself
+struct builtin {
+  const char* name;
+  void (*run)(struct command* cmd);
+  enum _bool inbkgd;  // run by the shell even with &, otherwise launched
+};
+
+// signal kill takes by name
+struct signame {
+  const char* name;
+  int signo;
+};
+
+// remembered location of a command
+struct hashentry {
+  char* name;
+  char* path;
+  int hits;   // number of times the location was used
+};
+
+// open addressing table from command name to location
+struct cmdhash {
+  struct hashentry* slots;
+  int size;   // number of slots, a power of 2
+  int n;      // number of slots used
+  char* path; // value of PATH the locations were found with
+};
+
 /* ****************************************************************************
  * global variables
  * ***************************************************************************/
 enum _bool fgOnly = _false;
+enum _bool useSpawn = _true;  // launch with posix_spawn, fork otherwise
+extern char** environ;
 static struct sigaction stopsig = {{0}};
 static struct sigaction termsig = {{0}};
+static struct cmdhash cmdhash = {0};
+static struct arena cmdarena = {0};
+static char pidstr[16];   // expansion of PIDVAR
+static int status = 0;    // status of last foreground command
+static struct job jobs[MAX_JOBS];
+static int selfpipe[2] = { -1, -1 };  // written to by SIGCHLD handler
+static FILE* cmdfile = NULL;  // where command lines are read from
+enum _bool interactive = _true; // cmdfile is a terminal
+enum _bool prompt = _true;      // print prompt before each command line
+static struct limits bglimits = { .set = _false, .pinned = _false };
+static struct limits* childlimits = NULL; // limits for commands being launched
+static const struct rlimitopt rlimitopts[] = {
+  { 't', RLIMIT_CPU, 1, "cpu time (seconds)" },
+  { 'f', RLIMIT_FSIZE, 1024, "file size (KB)" },
+  { 'd', RLIMIT_DATA, 1024, "data segment size (KB)" },
+  { 's', RLIMIT_STACK, 1024, "stack size (KB)" },
+  { 'n', RLIMIT_NOFILE, 1, "open files" },
+  { 'u', RLIMIT_NPROC, 1, "processes" },
+  { 'v', RLIMIT_AS, 1024, "virtual memory (KB)" },
+};
+#define NRLIMITOPTS (int) (sizeof(rlimitopts) / sizeof(rlimitopts[0]))
 
 /* ****************************************************************************
  * function declarations
@@ -62,16 +278,86 @@ void catchSignal();
 void catch_stopsig();
 void catch_termsig();
 void _catchstopsig(int signo);
+void _catchchldsig(int signo);
 void resetsigaction();
 
 // smallsh prog
-void _runshell(char** args, int n, char* infile, char* outfile);
+void _runshell(struct command* cmds, int n);
 char* getcmd();
-char** parseInput(int* n, char* input, char* infile, char* outfile);
-void _fork(char** args, int n, enum _bool bkgd, int* childExitStatus,
-    char* infile, char* outfile);
+struct command* parseInput(int* n, char* input);
+char* nextToken(char** input);
+char* expandToken(char* token);
+void _fork(struct command* cmds, int n, enum _bool bkgd, enum _bool timed);
+int launchpipeline(struct command* cmds, int n, pid_t* pids, int in,
+    int out, int err);
+pid_t launch(struct command* cmd, int in, int out, int err);
+enum _bool stalePath(const char* name, char** path);
+pid_t spawnChild(struct command* cmd, char* path, int in, int out, int err);
+pid_t forkChild(struct command* cmd, char* path, int in, int out, int err);
+
+// command hash
+unsigned int hashname(const char* name);
+struct hashentry* hashfind(const char* name);
+void hashadd(const char* name, const char* path);
+void hashremove(const char* name);
+void hashclear();
+char* searchpath(const char* name);
+char* commandPath(const char* name);
+void _hash(struct command* cmd);
+
+// job control
+struct job* addjob(struct command* cmds, int n, pid_t* pids);
+void removejob(struct job* job);
+struct job* findjob(const char* spec);
+void updatejob(pid_t pid, int childExitInteger, struct rusage* usage);
+void reapjobs();
+int waitjob(struct job* job);
+void printjob(struct job* job);
+void _jobs(struct command* cmd);
+void _wait(struct command* cmd);
+void _fg(struct command* cmd);
+void _bg(struct command* cmd);
+void killjobs();
+
+// resource controls
+void updatelimits();
+int parsecpus(const char* list, cpu_set_t* cpus);
+void applylimits(struct limits* limits);
+void _bgnice(struct command* cmd);
+void _bgcpus(struct command* cmd);
+void _bgulimit(struct command* cmd);
+void _bgcgroup(struct command* cmd);
+
+// parallel
+struct task* readtasks(FILE* fp, int* ntasks);
+int tmpfd();
+void copyout(int fd);
+void _parallel(struct command* cmd);
+
+// time cmd
+void addusage(struct rusage* total, struct rusage* usage);
+void showUsage(struct timespec* start, struct timespec* end,
+    struct rusage* usage);
+void timebuiltin(const struct builtin* builtin, struct command* cmd);
+
+// builtins
+void initbuiltins();
+const struct builtin* findbuiltin(const char* name);
+void runbuiltin(const struct builtin* builtin, struct command* cmd);
+void _exitshell(struct command* cmd);
+void _status(struct command* cmd);
+void _chdir(struct command* cmd);
+void _echo(struct command* cmd);
+void _pwd(struct command* cmd);
+void _truefalse(struct command* cmd);
+int testexpr(char** args, int n);
+void _test(struct command* cmd);
+void _printf(struct command* cmd);
+int signalnumber(const char* name);
+void _kill(struct command* cmd);
 
 // status cmd
+int exitvalue(int childExitInteger);
 void showStatus(int childExitInteger);
 void exitstatus(int childExitInteger);
 void signalstatus(int childExitInteger);
@@ -83,11 +369,51 @@ void _chfile(char** args, int n);
 int fileDirection(char* infile, char* outfile);
 
 // memory control
-void freeargs(char** args, int n);
+void* arenaAlloc(struct arena* arena, size_t n);
+void arenaReset(struct arena* arena);
 
 // debug
 void printargs(char** args);
 
+/* ****************************************************************************
+ * builtin table
+ * ***************************************************************************/
+static const struct builtin builtins[] = {
+  { EXIT, _exitshell, _true },
+  { CD, _chdir, _true },
+  { STATUS, _status, _true },
+  { HASH, _hash, _true },
+  { JOBS, _jobs, _true },
+  { WAIT, _wait, _true },
+  { FG, _fg, _true },
+  { BG, _bg, _true },
+  { BGNICE, _bgnice, _true },
+  { BGCPUS, _bgcpus, _true },
+  { BGULIMIT, _bgulimit, _true },
+  { BGCGROUP, _bgcgroup, _true },
+  { PARALLEL, _parallel, _true },
+  { ECHO, _echo, _false },
+  { PWD, _pwd, _false },
+  { TRUE, _truefalse, _false },
+  { FALSE, _truefalse, _false },
+  { TEST, _test, _false },
+  { BRACKET, _test, _false },
+  { PRINTF, _printf, _false },
+  { KILL, _kill, _false },
+};
+#define NBUILTINS (int) (sizeof(builtins) / sizeof(builtins[0]))
+static const struct builtin** builtintable = NULL;  // hashed by name
+static int builtinsize = 0; // number of slots in builtintable, a power of 2
+
+static const struct signame signames[] = {
+  { "HUP", SIGHUP }, { "INT", SIGINT }, { "QUIT", SIGQUIT },
+  { "KILL", SIGKILL }, { "USR1", SIGUSR1 }, { "USR2", SIGUSR2 },
+  { "PIPE", SIGPIPE }, { "ALRM", SIGALRM }, { "TERM", SIGTERM },
+  { "CHLD", SIGCHLD }, { "CONT", SIGCONT }, { "STOP", SIGSTOP },
+  { "TSTP", SIGTSTP }, { "TTIN", SIGTTIN }, { "TTOU", SIGTTOU },
+};
+#define NSIGNAMES (int) (sizeof(signames) / sizeof(signames[0]))
+
 /* ****************************************************************************
  * Description:
  * initializes signal handlers for stop and term
@@ -96,6 +422,18 @@ void catchSignal() {
   catch_stopsig();
   catch_termsig();
   resetsigaction();
+
+  // SIGCHLD wakes the prompt through a pipe, so jobs are reported as soon
+  // as they change state
+  if (pipe2(selfpipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+    perror("error: unable to create pipe");
+    exit(1);
+  }
+  struct sigaction chldsig = {{0}};
+  chldsig.sa_handler = _catchchldsig;
+  sigfillset(&chldsig.sa_mask);
+  chldsig.sa_flags = SA_RESTART;
+  sigaction(SIGCHLD, &chldsig, NULL);
 }
 
 // handler for stop (ctrl+z)
@@ -126,11 +464,34 @@ void _catchstopsig(int signo) {
   fflush(stdout);
 }
 
+// catch child signal, the children are reaped by the prompt loop
+void _catchchldsig(int signo) {
+  int saved = errno;
+  char ch = 0;
+  if (write(selfpipe[1], &ch, 1) == -1) {
+    // pipe is full, a wakeup is already pending
+  }
+  errno = saved;
+}
+
 // reset signal actions for stop and term
 void resetsigaction() {
   sigaction(SIGTSTP, &stopsig, NULL);
   sigaction(SIGINT, &termsig, NULL);
 }
+/* ****************************************************************************
+ * Description:
+ * returns status as the exit value of a shell: the command's exit value, or
+ * 128 plus the signal that terminated it
+ * @param childExitInteger
+ * ***************************************************************************/
+int exitvalue(int childExitInteger) {
+  if (WIFSIGNALED(childExitInteger)) {
+    return 128 + WTERMSIG(childExitInteger);
+  }
+  return WIFEXITED(childExitInteger) ? WEXITSTATUS(childExitInteger) : 1;
+}
+
 /* ****************************************************************************
  * Description:
  * Displays exit/signaled status to shell
@@ -160,13 +521,90 @@ void signalstatus(int childExitInteger) {
   }
 }
 
+/* ****************************************************************************
+ * Description:
+ * adds usage of a reaped command to total. max RSS is the largest of any
+ * one command, everything else is summed
+ * @param total
+ * @param usage
+ * ***************************************************************************/
+void addusage(struct rusage* total, struct rusage* usage) {
+  timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+  timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+  if (usage->ru_maxrss > total->ru_maxrss) {
+    total->ru_maxrss = usage->ru_maxrss;
+  }
+  total->ru_nvcsw += usage->ru_nvcsw;
+  total->ru_nivcsw += usage->ru_nivcsw;
+  total->ru_minflt += usage->ru_minflt;
+  total->ru_majflt += usage->ru_majflt;
+}
+
+/* ****************************************************************************
+ * Description:
+ * prints wall time from start to end and usage of a timed command line to
+ * stderr
+ * @param start
+ * @param end
+ * @param usage
+ * ***************************************************************************/
+void showUsage(struct timespec* start, struct timespec* end,
+    struct rusage* usage) {
+  long sec = end->tv_sec - start->tv_sec;
+  long nsec = end->tv_nsec - start->tv_nsec;
+  if (nsec < 0) {
+    sec--;
+    nsec += 1000000000L;
+  }
+
+  fflush(stdout);
+  fprintf(stderr, "real\t%ld.%03lds\n", sec, nsec / 1000000);
+  fprintf(stderr, "user\t%ld.%03lds\n", (long) usage->ru_utime.tv_sec,
+      (long) usage->ru_utime.tv_usec / 1000);
+  fprintf(stderr, "sys\t%ld.%03lds\n", (long) usage->ru_stime.tv_sec,
+      (long) usage->ru_stime.tv_usec / 1000);
+  fprintf(stderr, "maxrss\t%ld KB\n", usage->ru_maxrss);
+  fprintf(stderr, "ctxsw\t%ld voluntary, %ld involuntary\n",
+      usage->ru_nvcsw, usage->ru_nivcsw);
+  fprintf(stderr, "faults\t%ld minor, %ld major\n",
+      usage->ru_minflt, usage->ru_majflt);
+}
+
+/* ****************************************************************************
+ * Description:
+ * runs a timed builtin in the shell and prints its usage the same way as a
+ * timed command line. usage is what the shell used during the call, max RSS
+ * is the shell's own
+ * @param builtin
+ * @param cmd
+ * ***************************************************************************/
+void timebuiltin(const struct builtin* builtin, struct command* cmd) {
+  struct timespec start, end;
+  struct rusage before, usage;
+  getrusage(RUSAGE_SELF, &before);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  runbuiltin(builtin, cmd);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  getrusage(RUSAGE_SELF, &usage);
+  timersub(&usage.ru_utime, &before.ru_utime, &usage.ru_utime);
+  timersub(&usage.ru_stime, &before.ru_stime, &usage.ru_stime);
+  usage.ru_nvcsw -= before.ru_nvcsw;
+  usage.ru_nivcsw -= before.ru_nivcsw;
+  usage.ru_minflt -= before.ru_minflt;
+  usage.ru_majflt -= before.ru_majflt;
+  showUsage(&start, &end, &usage);
+}
+
 /* ****************************************************************************
  * Description:
  * change directory
- * @param args
- * @param input
+ * @param cmd
  * ***************************************************************************/
-void _chdir(char** args, int n) {
+void _chdir(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
   int ch;
   if (n > 1) {
     // change to directory indicated by argument 
@@ -181,29 +619,454 @@ void _chdir(char** args, int n) {
   }
 }
 
+/* ****************************************************************************
+ * Description:
+ * fills builtin table, doubling its size until every builtin has a slot of
+ * its own so a lookup is one hash and one compare
+ * ***************************************************************************/
+void initbuiltins() {
+  int size = BUILTINSIZE;
+  while (1) {
+    builtintable = calloc(size, sizeof(struct builtin*));
+    builtinsize = size;
+    enum _bool perfect = _true;
+    int i = 0;
+    for (; i < NBUILTINS; i++) {
+      unsigned int j = hashname(builtins[i].name) & (size - 1);
+      if (builtintable[j] != NULL) {
+        perfect = _false;
+        // probe linearly, in case no size is free of collisions
+        while (builtintable[j] != NULL) j = (j + 1) & (size - 1);
+      }
+      builtintable[j] = &builtins[i];
+    }
+    if (perfect == _true || size >= BUILTINMAX) {
+      return;
+    }
+    free(builtintable);
+    size *= 2;
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns builtin called name, or NULL if name isn't a builtin
+ * @param name
+ * ***************************************************************************/
+const struct builtin* findbuiltin(const char* name) {
+  unsigned int i = hashname(name) & (builtinsize - 1);
+  while (builtintable[i] != NULL) {
+    if (strcmp(builtintable[i]->name, name) == 0) {
+      return builtintable[i];
+    }
+    i = (i + 1) & (builtinsize - 1);
+  }
+  return NULL;
+}
+
+/* ****************************************************************************
+ * Description:
+ * runs builtin in the shell with cmd's output redirected. no builtin reads
+ * stdin, but a file cmd redirects input from still has to be readable.
+ * status becomes 1 if a file can't be opened
+ * @param builtin
+ * @param cmd
+ * ***************************************************************************/
+void runbuiltin(const struct builtin* builtin, struct command* cmd) {
+  if (cmd->infile != NULL && access(cmd->infile, R_OK) == -1) {
+    perror("error: unable to access file");
+    status = W_EXITCODE(1, 0);
+    return;
+  }
+
+  // point stdout at file, keeping shell's stdout to put back
+  int saved = -1;
+  if (cmd->outfile != NULL) {
+    int file = open(cmd->outfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        0644);
+    if (file == -1) {
+      perror("error: unable to access file");
+      status = W_EXITCODE(1, 0);
+      return;
+    }
+    fflush(stdout);
+    saved = fcntl(1, F_DUPFD_CLOEXEC, 10);
+    dup2(file, 1);
+    close(file);
+  }
+
+  builtin->run(cmd);
+
+  if (saved != -1) {
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * exit command: kills jobs and exits with status 0
+ * @param cmd
+ * ***************************************************************************/
+void _exitshell(struct command* cmd) {
+  killjobs();
+  exit(0);
+}
+
+/* ****************************************************************************
+ * Description:
+ * status command: prints status of last foreground command
+ * @param cmd
+ * ***************************************************************************/
+void _status(struct command* cmd) {
+  showStatus(status);
+}
+
+/* ****************************************************************************
+ * Description:
+ * echo command: prints its arguments separated by spaces, with no newline
+ * after them if the first is -n
+ * @param cmd
+ * ***************************************************************************/
+void _echo(struct command* cmd) {
+  int i = 1;
+  enum _bool newline = _true;
+  if (cmd->n > 1 && strcmp(cmd->args[1], "-n") == 0) {
+    newline = _false;
+    i++;
+  }
+  for (; i < cmd->n; i++) {
+    fputs(cmd->args[i], stdout);
+    if (i < cmd->n - 1) putchar(' ');
+  }
+  if (newline == _true) putchar('\n');
+  status = 0;
+}
+
+/* ****************************************************************************
+ * Description:
+ * pwd command: prints the working directory
+ * @param cmd
+ * ***************************************************************************/
+void _pwd(struct command* cmd) {
+  char* dir = getcwd(NULL, 0);
+  if (dir == NULL) {
+    perror("error: unable to access directory");
+    status = W_EXITCODE(1, 0);
+    return;
+  }
+  printf("%s\n", dir);
+  free(dir);
+  status = 0;
+}
+
+/* ****************************************************************************
+ * Description:
+ * true and false commands: status becomes 0 or 1
+ * @param cmd
+ * ***************************************************************************/
+void _truefalse(struct command* cmd) {
+  status = W_EXITCODE(strcmp(cmd->args[0], "false") == 0, 0);
+}
+
+/* ****************************************************************************
+ * Description:
+ * evaluates a test expression of n args: a string, a unary file or string
+ * test, a binary string or integer comparison, any of them after !. returns
+ * 0 if it's true, 1 if it's false and 2 if it isn't valid
+ * @param args
+ * @param n
+ * ***************************************************************************/
+int testexpr(char** args, int n) {
+  // no expression is false, a string is true unless it's empty
+  if (n == 0) return 1;
+  if (strcmp(args[0], "!") == 0 && n > 1) {
+    int res = testexpr(args + 1, n - 1);
+    return (res == 2) ? 2 : !res;
+  }
+  if (n == 1) return (args[0][0] == '\0');
+
+  // unary test
+  struct stat st;
+  if (n == 2 && args[0][0] == '-' && strlen(args[0]) == 2) {
+    const char* a = args[1];
+    switch (args[0][1]) {
+      case 'n': return (a[0] == '\0');
+      case 'z': return (a[0] != '\0');
+      case 'e': return (stat(a, &st) == -1);
+      case 'f': return (stat(a, &st) == -1 || !S_ISREG(st.st_mode));
+      case 'd': return (stat(a, &st) == -1 || !S_ISDIR(st.st_mode));
+      case 's': return (stat(a, &st) == -1 || st.st_size == 0);
+      case 'h':
+      case 'L': return (lstat(a, &st) == -1 || !S_ISLNK(st.st_mode));
+      case 'r': return (access(a, R_OK) == -1);
+      case 'w': return (access(a, W_OK) == -1);
+      case 'x': return (access(a, X_OK) == -1);
+    }
+    return 2;
+  }
+  if (n != 3) return 2;
+
+  // string comparison
+  const char* op = args[1];
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+    return (strcmp(args[0], args[2]) != 0);
+  }
+  if (strcmp(op, "!=") == 0) {
+    return (strcmp(args[0], args[2]) == 0);
+  }
+
+  // integer comparison
+  char* end1;
+  char* end2;
+  long a = strtol(args[0], &end1, 10);
+  long b = strtol(args[2], &end2, 10);
+  if (*end1 != '\0' || *end2 != '\0' || end1 == args[0] || end2 == args[2]) {
+    return 2;
+  }
+  if (strcmp(op, "-eq") == 0) return !(a == b);
+  if (strcmp(op, "-ne") == 0) return !(a != b);
+  if (strcmp(op, "-lt") == 0) return !(a < b);
+  if (strcmp(op, "-le") == 0) return !(a <= b);
+  if (strcmp(op, "-gt") == 0) return !(a > b);
+  if (strcmp(op, "-ge") == 0) return !(a >= b);
+  return 2;
+}
+
+/* ****************************************************************************
+ * Description:
+ * test and [ commands: status becomes 0 if the expression is true, 1 if
+ * it's false and 2 if it isn't valid. [ needs ] as its last argument
+ * @param cmd
+ * ***************************************************************************/
+void _test(struct command* cmd) {
+  int n = cmd->n - 1;
+  if (strcmp(cmd->args[0], "[") == 0) {
+    if (n == 0 || strcmp(cmd->args[n], "]") != 0) {
+      fprintf(stderr, "[: missing ]\n");
+      status = W_EXITCODE(2, 0);
+      return;
+    }
+    n--;
+  }
+  int res = testexpr(cmd->args + 1, n);
+  if (res == 2) {
+    fprintf(stderr, "%s: invalid expression\n", cmd->args[0]);
+  }
+  status = W_EXITCODE(res, 0);
+}
+
+/* ****************************************************************************
+ * Description:
+ * printf command: prints its arguments as the format says, reusing the
+ * format while arguments are left. supports \ escapes and the conversions
+ * d i u o x X c s with flags, width and precision
+ * @param cmd
+ * ***************************************************************************/
+void _printf(struct command* cmd) {
+  if (cmd->n < 2) {
+    fprintf(stderr, "usage: printf format [arguments]\n");
+    status = W_EXITCODE(2, 0);
+    return;
+  }
+  const char* format = cmd->args[1];
+  char** args = cmd->args + 2;
+  int n = cmd->n - 2;
+  int next = 0;   // idx of next argument to print
+  int first;
+  do {
+    first = next;
+    const char* p = format;
+    while (*p != '\0') {
+      // escape
+      if (*p == '\\' && p[1] != '\0') {
+        const char* from = "ntrabfv\\";
+        const char* to = "\n\t\r\a\b\f\v\\";
+        const char* esc = strchr(from, p[1]);
+        if (esc != NULL) {
+          putchar(to[esc - from]);
+        } else {
+          putchar(p[0]);
+          putchar(p[1]);
+        }
+        p += 2;
+        continue;
+      }
+      if (*p != '%') {
+        putchar(*p++);
+        continue;
+      }
+      if (p[1] == '%') {
+        putchar('%');
+        p += 2;
+        continue;
+      }
+
+      // conversion, printed with printf() given spec made from it
+      char spec[32];
+      size_t len = strspn(p + 1, "-+ #0123456789.") + 1;
+      char conv = p[len];
+      if (len + 3 > sizeof(spec) || strchr("diuoxXcs", conv) == NULL ||
+          conv == '\0') {
+        fprintf(stderr, "printf: %.*s: invalid conversion\n",
+            (int) len + (conv != '\0'), p);
+        status = W_EXITCODE(1, 0);
+        return;
+      }
+      memcpy(spec, p, len);
+      const char* arg = (next < n) ? args[next++] : "";
+      if (conv == 's' || conv == 'c') {
+        spec[len] = conv;
+        spec[len + 1] = '\0';
+        if (conv == 's') printf(spec, arg);
+        else if (arg[0] != '\0') printf(spec, arg[0]);
+      } else {
+        spec[len] = 'l';
+        spec[len + 1] = (conv == 'i') ? 'd' : conv;
+        spec[len + 2] = '\0';
+        if (conv == 'd' || conv == 'i') printf(spec, strtol(arg, NULL, 0));
+        else printf(spec, strtoul(arg, NULL, 0));
+      }
+      p += len + 1;
+    }
+  } while (next < n && next > first);
+  status = 0;
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns number of signal given as a number or a name such as TERM or
+ * SIGTERM, or -1 if there's no such signal
+ * @param name
+ * ***************************************************************************/
+int signalnumber(const char* name) {
+  if (isdigit((unsigned char) name[0])) {
+    int signo = atoi(name);
+    return (signo < NSIG) ? signo : -1;
+  }
+  if (strncmp(name, "SIG", 3) == 0) {
+    name += 3;
+  }
+  int i = 0;
+  for (; i < NSIGNAMES; i++) {
+    if (strcmp(signames[i].name, name) == 0) {
+      return signames[i].signo;
+    }
+  }
+  return -1;
+}
+
+/* ****************************************************************************
+ * Description:
+ * kill command: sends a signal (-SIG, -s SIG, TERM if not given) to each pid
+ * or job (%id). status becomes 1 if any couldn't be signaled
+ * @param cmd
+ * ***************************************************************************/
+void _kill(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  int signo = SIGTERM;
+  int i = 1;
+  if (i + 1 < n && strcmp(args[i], "-s") == 0) {
+    signo = signalnumber(args[i + 1]);
+    i += 2;
+  } else if (i < n && args[i][0] == '-' && args[i][1] != '\0') {
+    signo = signalnumber(args[i] + 1);
+    i++;
+  }
+  if (signo == -1) {
+    fprintf(stderr, "kill: %s: invalid signal\n", args[i - 1]);
+    status = W_EXITCODE(2, 0);
+    return;
+  }
+  if (i == n) {
+    fprintf(stderr, "usage: kill [-s sig | -sig] pid|%%id...\n");
+    status = W_EXITCODE(2, 0);
+    return;
+  }
+
+  int res = 0;
+  for (; i < n; i++) {
+    // signal every command of a job
+    if (args[i][0] == '%') {
+      struct job* job = findjob(args[i]);
+      if (job == NULL) {
+        fprintf(stderr, "kill: %s: no such job\n", args[i]);
+        res = 1;
+        continue;
+      }
+      int j = 0;
+      for (; j < job->n; j++) {
+        if (job->pids[j] != 0) kill(job->pids[j], signo);
+      }
+      continue;
+    }
+
+    char* end;
+    pid_t pid = strtol(args[i], &end, 10);
+    if (*end != '\0' || end == args[i]) {
+      fprintf(stderr, "kill: %s: not a pid or job\n", args[i]);
+      res = 1;
+    } else if (kill(pid, signo) == -1) {
+      fprintf(stderr, "kill: %s: %s\n", args[i], strerror(errno));
+      res = 1;
+    }
+  }
+  status = W_EXITCODE(res, 0);
+}
+
 /* ****************************************************************************
  * Description: [reference: lecture notes]
- * repeatedly gets input from user until valid and stores it
- * @param input
+ * repeatedly gets input from user until valid and stores it. the line is
+ * read into the same buffer every time, valid until the next call. exits
+ * at the end of input that isn't a terminal
  * ***************************************************************************/
 char* getcmd() {
   // clear input/output command line buffers
   fflush(stdout);
-  fflush(stdin);
+  if (interactive == _true) {
+    fflush(stdin);
+  }
 
   // get input
-  char* input = NULL;
-  size_t buffer = 0; // Holds how large the allocated buffer is
+  static char* input = NULL;
+  static size_t buffer = 0; // Holds how large the allocated buffer is
   int chars = -5;   // number of chars entered
   while(1) {
-    printf(": ");
+    reapjobs();
+    if (prompt == _true) {
+      printf(": ");
+    }
+
+    // at a terminal, report jobs that finish while waiting for input
+    if (interactive == _true) {
+      fflush(stdout);
+      struct pollfd fds[2] = { { fileno(cmdfile), POLLIN, 0 },
+        { selfpipe[0], POLLIN, 0 } };
+      while (poll(fds, 2, -1) == -1 || (fds[0].revents == 0 &&
+            fds[1].revents != 0)) {
+        if (fds[1].revents != 0) {
+          printf("\n");
+          reapjobs();
+          printf(": ");
+          fflush(stdout);
+        }
+        fds[0].revents = fds[1].revents = 0;
+      }
+    }
 
     // Get a line from the user
-    chars = getline(&input, &buffer, stdin); // result of reading line
+    chars = getline(&input, &buffer, cmdfile); // result of reading line
+
+    // end of script or piped input, exit with status of last command
+    if (chars == -1 && interactive == _false) {
+      exit(exitvalue(status));
+    }
 
     // check if line was read and if leading w/ # (comment)
     if (chars == -1 || input[0] == '#') {
-      clearerr(stdin);
+      clearerr(cmdfile);
     } else
       // Exit the loop - we've got input
       break; 
@@ -216,21 +1079,90 @@ char* getcmd() {
 
 /* ****************************************************************************
  * Description:
- * Parses string considering ' ' and returns segments input
- * and stores number of segments
- * @param nArgs
+ * returns next token of input, ending it in place with \0 and moving input
+ * past it. returns NULL when no tokens are left
+ * @param input
+ * ***************************************************************************/
+char* nextToken(char** input) {
+  char* p = *input;
+  // skip leading spaces
+  while (*p == ' ') p++;
+  if (*p == '\0') {
+    *input = p;
+    return NULL;
+  }
+
+  // find end of token
+  char* token = p;
+  while (*p != ' ' && *p != '\0') p++;
+  if (*p == ' ') *p++ = '\0';
+  *input = p;
+  return token;
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns token with every PIDVAR replaced by pid of shell. a token without
+ * PIDVAR is returned as is, otherwise the expansion is made in the arena
+ * @param token
+ * ***************************************************************************/
+char* expandToken(char* token) {
+  char* needle = strstr(token, PIDVAR);
+  if (needle == NULL) {
+    return token;
+  }
+
+  // count occurrences to size expansion
+  int count = 0;
+  for (; needle != NULL; needle = strstr(needle + 2, PIDVAR)) count++;
+  size_t pidlen = strlen(pidstr);
+  char* expanded = arenaAlloc(&cmdarena,
+      strlen(token) + count * (pidlen - 2) + 1);
+
+  // copy token, replacing each occurrence
+  char* out = expanded;
+  while ((needle = strstr(token, PIDVAR)) != NULL) {
+    memcpy(out, token, needle - token);
+    out += needle - token;
+    memcpy(out, pidstr, pidlen);
+    out += pidlen;
+    token = needle + 2;
+  }
+  strcpy(out, token);
+  return expanded;
+}
+
+/* ****************************************************************************
+ * Description:
+ * Parses string considering ' ' and returns the commands of the line, which
+ * are separated by PIPE, and stores number of commands. tokens are sliced in
+ * place from input and everything else comes from the command line arena, so
+ * nothing is freed. returns NULL if a command of a pipeline is empty
+ * @param nCmds
  * @param input
  * ***************************************************************************/
-char** parseInput(int* nArgs, char* input, char* infile, char* outfile) {
-  // reset file names
-  strcpy(infile, "\0");
-  strcpy(outfile, "\0");
+struct command* parseInput(int* nCmds, char* input) {
+  // every | at most separates two commands
+  int m = 1;
+  char* p = input;
+  for (; *p != '\0'; p++) {
+    if (*p == '|') m++;
+  }
+  struct command* cmds = arenaAlloc(&cmdarena, sizeof(struct command) * m);
+
+  // get segments for command arguments, every other char at most starts one
+  // and each command's args end with NULL
+  char** args = arenaAlloc(&cmdarena,
+      sizeof(char*) * (strlen(input) / 2 + 1 + m));
+  int n = 0;    // idx for commands in input
+  struct command* cmd = &cmds[0];
+  cmd->args = args;
+  cmd->n = 0;
+  cmd->infile = NULL;
+  cmd->outfile = NULL;
 
-  // get segments for command arguments
-  int n = 0;    // idx for segments in input;
-  char** args = malloc(sizeof(char*) * ARGBUFF);
-  char* token = strtok(input, " \n");
-  while(token != NULL) {
+  char* token;
+  while((token = nextToken(&input)) != NULL) {
 
     // check if # for comment
     if (token[0] == '#') {
@@ -239,47 +1171,54 @@ char** parseInput(int* nArgs, char* input, char* infile, char* outfile) {
 
     // check for file redirection
     if (strcmp(token, "<") == 0) {
-      token = strtok(NULL, " ");
-      strcpy(infile, token);
+      cmd->infile = nextToken(&input);
 
       // check for file redirection
     } else if (strcmp(token, ">") == 0) {
-      token = strtok(NULL, " ");
-      strcpy(outfile, token);
+      cmd->outfile = nextToken(&input);
 
-      // duplicate argument to args list
-    } else {
-      // save token as segment
-      char* curr = malloc(sizeof(char) * BUFFER);
-      sprintf(curr, "%s", token);
-
-      // check for variable expansion--pid
-      char* needleptr = strstr(curr, "$$");
-      if (needleptr != NULL) {
-        // printf("needleptr: %s\n", needleptr);
-        needleptr[0] = '\0';
-        // replace with pid
-        sprintf(curr, "%s%d", curr, getpid());
+      // end command, start next command of pipeline
+    } else if (strcmp(token, PIPE) == 0) {
+      if (cmd->n == 0) {
+        n = -1;
+        break;
       }
+      cmd->args[cmd->n] = NULL;
+      args += cmd->n + 1;
+      cmd = &cmds[++n];
+      cmd->args = args;
+      cmd->n = 0;
+      cmd->infile = NULL;
+      cmd->outfile = NULL;
 
-      // save segment of argument for return
-      args[n++] = curr;
+      // save segment of argument, expanding pid
+    } else {
+      cmd->args[cmd->n++] = expandToken(token);
     }
-    // update token
-    token = strtok(NULL, " \n");
   }
+  cmd->args[cmd->n] = NULL;
 
-  *nArgs = n;
+  // every command of a pipeline needs a program to run
+  if (n < 0 || (cmd->n == 0 && n > 0)) {
+    fprintf(stderr, "error: syntax error near %s\n", PIPE);
+    *nCmds = 0;
+    return NULL;
+  }
+
+  *nCmds = (cmd->n == 0) ? n : n + 1;
   fflush(stdout);
-  fflush(stdin);
-  // printargs(args);
-  return args;
+  if (interactive == _true) {
+    fflush(stdin);
+  }
+  // printargs(cmds[0].args);
+  return (*nCmds > 0) ? cmds : NULL;
 }
 
 /* ****************************************************************************
  * Description:
  * check if there is a file direction in command, sets direction if occurs
- * and returns 1 if redirection occurs, 0 otherwise
+ * and returns 1 if redirection occurs, 0 otherwise. only called in a forked
+ * child, which _exits if a file can't be opened
  * @param infile
  * @param outfile
  * ***************************************************************************/
@@ -287,13 +1226,13 @@ int fileDirection(char* infile, char* outfile) {
   int res = 0;
   // handle file redirection 
   // input file
-  if (strcmp(infile, "") != 0) {
+  if (infile != NULL) {
     // attempt to open file
     int file = open(infile, O_RDONLY);
     // check if file is opened/dup made
     if (file == -1 || dup2(file, 0) == -1) {
       perror("error: unable to access file");
-      exit(1);
+      _exit(1);
     }
     // update return value
     res = 1;
@@ -302,13 +1241,13 @@ int fileDirection(char* infile, char* outfile) {
   }
 
   // output file
-  if (strcmp(outfile, "") != 0) {
+  if (outfile != NULL) {
     // attempt to open file
     int file = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     // check if file is opened/dup made
     if (file == -1 || dup2(file, 1) == -1) {
       perror("error: unable to access file");
-      exit(1);
+      _exit(1);
     } 
     // update return value
     res = 1;
@@ -321,18 +1260,1082 @@ int fileDirection(char* infile, char* outfile) {
 
 /* ****************************************************************************
  * Description:
- * creates fork for all other commands
- * @param args
- * @param n
- * @param bkgd
- * @param childExitStatus
- * @param infile
- * @param outfile
+ * returns hash of command name (fnv-1a)
+ * @param name
  * ***************************************************************************/
-void _fork(char** args, int n, enum _bool bkgd, int* childExitStatus,
-    char* infile, char* outfile) {
-  // create a fork for process
-  pid_t pid = fork();
+unsigned int hashname(const char* name) {
+  unsigned int h = 2166136261u;
+  for (; *name != '\0'; name++) {
+    h = (h ^ (unsigned char) *name) * 16777619u;
+  }
+  return h;
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns slot for name in command hash: the slot holding name, or the empty
+ * slot it would be added to. returns NULL if the hash has no slots
+ * @param name
+ * ***************************************************************************/
+struct hashentry* hashfind(const char* name) {
+  if (cmdhash.size == 0) {
+    return NULL;
+  }
+  // probe linearly from the home slot of name
+  unsigned int i = hashname(name) & (cmdhash.size - 1);
+  while (cmdhash.slots[i].name != NULL &&
+      strcmp(cmdhash.slots[i].name, name) != 0) {
+    i = (i + 1) & (cmdhash.size - 1);
+  }
+  return &cmdhash.slots[i];
+}
+
+/* ****************************************************************************
+ * Description:
+ * remembers path as location of name, doubling the table when half full
+ * @param name
+ * @param path
+ * ***************************************************************************/
+void hashadd(const char* name, const char* path) {
+  // grow table, re-adding every entry to its new slot
+  if (2 * (cmdhash.n + 1) > cmdhash.size) {
+    struct hashentry* old = cmdhash.slots;
+    int oldsize = cmdhash.size;
+    cmdhash.size = (oldsize == 0) ? HASHSIZE : 2 * oldsize;
+    cmdhash.slots = calloc(cmdhash.size, sizeof(struct hashentry));
+    int i = 0;
+    for (; i < oldsize; i++) {
+      if (old[i].name != NULL) {
+        *hashfind(old[i].name) = old[i];
+      }
+    }
+    free(old);
+  }
+
+  struct hashentry* entry = hashfind(name);
+  if (entry->name == NULL) {
+    entry->name = strdup(name);
+    cmdhash.n++;
+  } else {
+    free(entry->path);
+  }
+  entry->path = strdup(path);
+  entry->hits = 0;
+}
+
+/* ****************************************************************************
+ * Description:
+ * forgets location of name. entries after it in the same run of slots are
+ * re-added so probing still finds them
+ * @param name
+ * ***************************************************************************/
+void hashremove(const char* name) {
+  struct hashentry* entry = hashfind(name);
+  if (entry == NULL || entry->name == NULL) {
+    return;
+  }
+  free(entry->name);
+  free(entry->path);
+  entry->name = NULL;
+  entry->path = NULL;
+  cmdhash.n--;
+
+  unsigned int i = (entry - cmdhash.slots + 1) & (cmdhash.size - 1);
+  while (cmdhash.slots[i].name != NULL) {
+    struct hashentry moved = cmdhash.slots[i];
+    cmdhash.slots[i].name = NULL;
+    cmdhash.slots[i].path = NULL;
+    *hashfind(moved.name) = moved;
+    i = (i + 1) & (cmdhash.size - 1);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * forgets all command locations
+ * ***************************************************************************/
+void hashclear() {
+  int i = 0;
+  for (; i < cmdhash.size; i++) {
+    free(cmdhash.slots[i].name);
+    free(cmdhash.slots[i].path);
+  }
+  free(cmdhash.slots);
+  free(cmdhash.path);
+  memset(&cmdhash, 0, sizeof(cmdhash));
+}
+
+/* ****************************************************************************
+ * Description:
+ * searches each directory in PATH for an executable file called name, the
+ * way execvp() does. returns malloc'd path of file or NULL if not found
+ * @param name
+ * ***************************************************************************/
+char* searchpath(const char* name) {
+  const char* dirs = getenv(PATH);
+  if (dirs == NULL) {
+    dirs = DEFPATH;
+  }
+
+  char file[BUFFER];
+  struct stat st;
+  while (1) {
+    // get next directory, an empty one means the current directory
+    size_t len = strcspn(dirs, ":");
+    if (len == 0) {
+      snprintf(file, sizeof(file), "%s", name);
+    } else {
+      snprintf(file, sizeof(file), "%.*s/%s", (int) len, dirs, name);
+    }
+
+    // check if file is executable
+    if (stat(file, &st) == 0 && S_ISREG(st.st_mode) &&
+        access(file, X_OK) == 0) {
+      return strdup(file);
+    }
+
+    if (dirs[len] == '\0') {
+      return NULL;
+    }
+    dirs += len + 1;
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns location of command name, using the command hash so PATH is only
+ * searched the first time a command is used. the hash is cleared when PATH
+ * has changed since it was filled. returns NULL if the command has a / in it
+ * or isn't found
+ * @param name
+ * ***************************************************************************/
+char* commandPath(const char* name) {
+  if (strchr(name, '/') != NULL) {
+    return NULL;
+  }
+
+  // forget locations found with a different PATH
+  const char* path = getenv(PATH);
+  if (path == NULL) {
+    path = DEFPATH;
+  }
+  if (cmdhash.path == NULL || strcmp(cmdhash.path, path) != 0) {
+    hashclear();
+    cmdhash.path = strdup(path);
+  }
+
+  // use remembered location
+  struct hashentry* entry = hashfind(name);
+  if (entry == NULL || entry->name == NULL) {
+    // search PATH and remember location
+    char* file = searchpath(name);
+    if (file == NULL) {
+      return NULL;
+    }
+    hashadd(name, file);
+    free(file);
+    entry = hashfind(name);
+  }
+  entry->hits++;
+  return entry->path;
+}
+
+/* ****************************************************************************
+ * Description:
+ * hash command: with no arguments prints remembered command locations, with
+ * -r forgets them all, otherwise looks up and remembers each named command
+ * @param cmd
+ * ***************************************************************************/
+void _hash(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  // clear hash
+  if (n > 1 && strcmp(args[1], "-r") == 0) {
+    hashclear();
+    return;
+  }
+
+  // remember named commands
+  if (n > 1) {
+    int i = 1;
+    for (; i < n; i++) {
+      if (commandPath(args[i]) == NULL) {
+        fprintf(stderr, "hash: %s: not found\n", args[i]);
+      } else {
+        hashfind(args[i])->hits--;  // looking up isn't a use
+      }
+    }
+    return;
+  }
+
+  // print hash
+  if (cmdhash.n == 0) {
+    printf("hash: hash table empty\n");
+  } else {
+    printf("hits\tcommand\n");
+    int i = 0;
+    for (; i < cmdhash.size; i++) {
+      if (cmdhash.slots[i].name != NULL) {
+        printf("%4d\t%s\n", cmdhash.slots[i].hits, cmdhash.slots[i].path);
+      }
+    }
+  }
+  fflush(stdout);
+}
+
+/* ****************************************************************************
+ * Description:
+ * adds the launched commands of a command line to the job table, returns
+ * the job or NULL if the table is full
+ * @param cmds
+ * @param n
+ * @param pids
+ * ***************************************************************************/
+struct job* addjob(struct command* cmds, int n, pid_t* pids) {
+  // find free slot, its position gives the job id
+  int i = 0;
+  while (i < MAX_JOBS && jobs[i].id != 0) i++;
+  if (i == MAX_JOBS) {
+    return NULL;
+  }
+  struct job* job = &jobs[i];
+  job->id = i + 1;
+  job->n = n;
+  job->live = n;
+  job->status = 0;
+  job->state = RUNNING;
+  job->shown = RUNNING;
+  job->timed = _false;
+  memset(&job->usage, 0, sizeof(job->usage));
+  job->last = pids[n - 1];
+  job->pids = malloc(sizeof(pid_t) * n);
+  memcpy(job->pids, pids, sizeof(pid_t) * n);
+
+  // join commands back into a command line
+  size_t len = 1;
+  int j, k;
+  for (j = 0; j < n; j++) {
+    for (k = 0; k < cmds[j].n; k++) len += strlen(cmds[j].args[k]) + 3;
+  }
+  job->cmdline = malloc(len);
+  job->cmdline[0] = '\0';
+  for (j = 0; j < n; j++) {
+    if (j > 0) strcat(job->cmdline, " " PIPE);
+    for (k = 0; k < cmds[j].n; k++) {
+      if (j > 0 || k > 0) strcat(job->cmdline, " ");
+      strcat(job->cmdline, cmds[j].args[k]);
+    }
+  }
+  return job;
+}
+
+/* ****************************************************************************
+ * Description:
+ * frees job's slot in the job table
+ * @param job
+ * ***************************************************************************/
+void removejob(struct job* job) {
+  free(job->pids);
+  free(job->cmdline);
+  memset(job, 0, sizeof(struct job));
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns job given as %id or as the pid of one of its commands, or the most
+ * recent job if spec is NULL. returns NULL if there's no such job
+ * @param spec
+ * ***************************************************************************/
+struct job* findjob(const char* spec) {
+  int i = MAX_JOBS - 1;
+  // most recent job has the highest id
+  if (spec == NULL) {
+    for (; i >= 0; i--) {
+      if (jobs[i].id != 0) return &jobs[i];
+    }
+    return NULL;
+  }
+
+  // by job id
+  if (spec[0] == '%') {
+    i = atoi(spec + 1) - 1;
+    return (i >= 0 && i < MAX_JOBS && jobs[i].id != 0) ? &jobs[i] : NULL;
+  }
+
+  // by pid
+  pid_t pid = atoi(spec);
+  for (; i >= 0; i--) {
+    int j = 0;
+    for (; jobs[i].id != 0 && j < jobs[i].n; j++) {
+      if (jobs[i].pids[j] == pid) return &jobs[i];
+    }
+  }
+  return NULL;
+}
+
+/* ****************************************************************************
+ * Description:
+ * records a state change of pid reported by wait4() in the job it's part
+ * of. the job is done once all its commands have been reaped
+ * @param pid
+ * @param childExitInteger
+ * @param usage: usage of pid, NULL if unknown
+ * ***************************************************************************/
+void updatejob(pid_t pid, int childExitInteger, struct rusage* usage) {
+  int i = 0;
+  for (; i < MAX_JOBS; i++) {
+    struct job* job = &jobs[i];
+    int j = 0;
+    for (; job->id != 0 && j < job->n; j++) {
+      if (job->pids[j] != pid) continue;
+
+      if (WIFSTOPPED(childExitInteger)) {
+        job->state = STOPPED;
+      } else if (WIFCONTINUED(childExitInteger)) {
+        job->state = RUNNING;
+      } else {
+        // command has exited or was killed
+        if (j == job->n - 1) job->status = childExitInteger;
+        if (usage != NULL) addusage(&job->usage, usage);
+        job->pids[j] = 0;
+        if (--job->live == 0) {
+          job->state = DONE;
+          clock_gettime(CLOCK_MONOTONIC, &job->end);
+        }
+      }
+      return;
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * reaps every child that changed state since the last call and reports jobs
+ * that are done or stopped. done jobs are removed from the job table
+ * ***************************************************************************/
+void reapjobs() {
+  // empty the wakeup pipe before reaping so no SIGCHLD is missed
+  char drain[64];
+  while (read(selfpipe[0], drain, sizeof(drain)) > 0) {}
+
+  int childExitInteger;
+  struct rusage usage;
+  pid_t pid;
+  while ((pid = wait4(-1, &childExitInteger,
+          WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
+    updatejob(pid, childExitInteger, &usage);
+  }
+
+  // report jobs that changed state
+  int i = 0;
+  for (; i < MAX_JOBS; i++) {
+    struct job* job = &jobs[i];
+    if (job->id == 0 || job->state == job->shown) continue;
+    if (job->state == DONE) {
+      // same message as before jobs were tracked, given for last command
+      printf("background process %d is done: ", job->last);
+      showStatus(job->status);
+      if (job->timed == _true) {
+        showUsage(&job->start, &job->end, &job->usage);
+      }
+      removejob(job);
+    } else {
+      printjob(job);
+      job->shown = job->state;
+    }
+  }
+  fflush(stdout);
+}
+
+/* ****************************************************************************
+ * Description:
+ * waits in the foreground until every command of job has finished or one is
+ * stopped. returns status of last command, the job is removed once done.
+ * any child is reaped meanwhile, so background jobs that finish first are
+ * done when they finish and reported at the next prompt
+ * @param job
+ * ***************************************************************************/
+int waitjob(struct job* job) {
+  while (job->state == RUNNING) {
+    int childExitInteger;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &childExitInteger, WUNTRACED, &usage);
+    if (pid == -1) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    updatejob(pid, childExitInteger, &usage);
+  }
+
+  int result = job->status;
+  if (job->state == STOPPED) {
+    // leave job in the table so it can be continued
+    printf("\n");
+    printjob(job);
+    job->shown = STOPPED;
+    result = W_STOPCODE(SIGTSTP);
+  } else {
+    if (job->timed == _true) {
+      showUsage(&job->start, &job->end, &job->usage);
+    }
+    removejob(job);
+  }
+  return result;
+}
+
+/* ****************************************************************************
+ * Description:
+ * prints a line describing job
+ * @param job
+ * ***************************************************************************/
+void printjob(struct job* job) {
+  const char* state = "Running";
+  if (job->state == STOPPED) state = "Stopped";
+  if (job->state == DONE) state = "Done";
+  printf("[%d] %-8s %d\t%s\n", job->id, state, job->last, job->cmdline);
+  fflush(stdout);
+}
+
+/* ****************************************************************************
+ * Description:
+ * jobs command: prints every job in the job table
+ * @param cmd
+ * ***************************************************************************/
+void _jobs(struct command* cmd) {
+  reapjobs();
+  int i = 0;
+  for (; i < MAX_JOBS; i++) {
+    if (jobs[i].id != 0) {
+      printjob(&jobs[i]);
+      jobs[i].shown = jobs[i].state;
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * wait command: waits for each job given as %id or pid, or for every job if
+ * none are given. status becomes the status of the last job waited for
+ * @param cmd
+ * ***************************************************************************/
+void _wait(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  if (n > 1) {
+    int i = 1;
+    for (; i < n; i++) {
+      struct job* job = findjob(args[i]);
+      if (job == NULL) {
+        fprintf(stderr, "wait: %s: no such job\n", args[i]);
+        continue;
+      }
+      status = waitjob(job);
+    }
+    return;
+  }
+
+  // wait for all running jobs
+  int i = 0;
+  for (; i < MAX_JOBS; i++) {
+    if (jobs[i].id != 0 && jobs[i].state != STOPPED) {
+      status = waitjob(&jobs[i]);
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * fg command: continues a job in the foreground and waits for it
+ * @param cmd
+ * ***************************************************************************/
+void _fg(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  struct job* job = findjob(n > 1 ? args[1] : NULL);
+  if (job == NULL) {
+    fprintf(stderr, "fg: %s: no such job\n", n > 1 ? args[1] : "current");
+    return;
+  }
+  printf("%s\n", job->cmdline);
+  fflush(stdout);
+
+  // continue every command still alive
+  int i = 0;
+  for (; i < job->n; i++) {
+    if (job->pids[i] != 0) kill(job->pids[i], SIGCONT);
+  }
+  job->state = RUNNING;
+  job->shown = RUNNING;
+
+  status = waitjob(job);
+  signalstatus(status);
+}
+
+/* ****************************************************************************
+ * Description:
+ * bg command: continues a stopped job in the background
+ * @param cmd
+ * ***************************************************************************/
+void _bg(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  struct job* job = findjob(n > 1 ? args[1] : NULL);
+  if (job == NULL) {
+    fprintf(stderr, "bg: %s: no such job\n", n > 1 ? args[1] : "current");
+    return;
+  }
+
+  int i = 0;
+  for (; i < job->n; i++) {
+    if (job->pids[i] != 0) kill(job->pids[i], SIGCONT);
+  }
+  job->state = RUNNING;
+  job->shown = RUNNING;
+  printjob(job);
+}
+
+/* ****************************************************************************
+ * Description:
+ * kills every job, used when the shell exits
+ * ***************************************************************************/
+void killjobs() {
+  int i = 0;
+  for (; i < MAX_JOBS; i++) {
+    int j = 0;
+    for (; jobs[i].id != 0 && j < jobs[i].n; j++) {
+      if (jobs[i].pids[j] != 0) {
+        kill(jobs[i].pids[j], SIGTERM);
+        kill(jobs[i].pids[j], SIGCONT);
+      }
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * marks whether any resource control is set for background commands, they
+ * are launched with fork() to apply them only if so
+ * ***************************************************************************/
+void updatelimits() {
+  bglimits.set = (bglimits.nice != 0 || bglimits.pinned == _true ||
+      bglimits.rlimset != 0 || bglimits.cgroup != NULL) ? _true : _false;
+}
+
+/* ****************************************************************************
+ * Description:
+ * parses a list of cpus such as 0-3,6 into cpus. returns 0, or -1 if list
+ * isn't valid or is empty
+ * @param list
+ * @param cpus
+ * ***************************************************************************/
+int parsecpus(const char* list, cpu_set_t* cpus) {
+  CPU_ZERO(cpus);
+  while (*list != '\0') {
+    // get cpu or range of cpus
+    char* end;
+    long lo = strtol(list, &end, 10);
+    long hi = lo;
+    if (end == list || lo < 0) return -1;
+    if (*end == '-') {
+      list = end + 1;
+      hi = strtol(list, &end, 10);
+      if (end == list || hi < lo) return -1;
+    }
+    if (hi >= CPU_SETSIZE) return -1;
+    for (; lo <= hi; lo++) CPU_SET(lo, cpus);
+
+    if (*end == ',') end++;
+    else if (*end != '\0') return -1;
+    list = end;
+  }
+  return (CPU_COUNT(cpus) > 0) ? 0 : -1;
+}
+
+/* ****************************************************************************
+ * Description:
+ * applies limits to the calling process, run by the forked child before it
+ * execs. the child _exits with 1 if a control can't be applied, so it doesn't
+ * flush or close the stdio it shares with the shell
+ * @param limits
+ * ***************************************************************************/
+void applylimits(struct limits* limits) {
+  // join cgroup first so everything after is accounted to it
+  if (limits->cgroup != NULL) {
+    char file[BUFFER];
+    char pid[16];
+    snprintf(file, sizeof(file), "%s/%s", limits->cgroup, CGROUP_PROCS);
+    int len = snprintf(pid, sizeof(pid), "%d\n", getpid());
+    int fd = open(file, O_WRONLY | O_CLOEXEC);
+    if (fd == -1 || write(fd, pid, len) != len) {
+      perror("error: unable to join cgroup");
+      _exit(1);
+    }
+    close(fd);
+  }
+
+  int i = 0;
+  for (; i < RLIMIT_NLIMITS; i++) {
+    if ((limits->rlimset & (1 << i)) != 0 &&
+        setrlimit(i, &limits->rlim[i]) == -1) {
+      perror("error: unable to set resource limit");
+      _exit(1);
+    }
+  }
+
+  if (limits->nice != 0) {
+    errno = 0;
+    if (nice(limits->nice) == -1 && errno != 0) {
+      perror("error: unable to set niceness");
+      _exit(1);
+    }
+  }
+
+  if (limits->pinned == _true &&
+      sched_setaffinity(0, sizeof(cpu_set_t), &limits->cpus) == -1) {
+    perror("error: unable to set cpus");
+    _exit(1);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * bgnice command: sets the niceness added to background commands, prints it
+ * with no arguments
+ * @param cmd
+ * ***************************************************************************/
+void _bgnice(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  if (n < 2) {
+    printf("%d\n", bglimits.nice);
+    fflush(stdout);
+    return;
+  }
+
+  char* end;
+  long inc = strtol(args[1], &end, 10);
+  if (*end != '\0' || end == args[1] || inc < -40 || inc > 40) {
+    fprintf(stderr, "bgnice: %s: not a niceness\n", args[1]);
+    return;
+  }
+  bglimits.nice = inc;
+  updatelimits();
+}
+
+/* ****************************************************************************
+ * Description:
+ * bgcpus command: sets the cpus background commands run on, as a list such
+ * as 0-3,6, or any cpu with all. prints them with no arguments
+ * @param cmd
+ * ***************************************************************************/
+void _bgcpus(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  if (n < 2) {
+    printf("%s\n", bglimits.pinned == _true ? bglimits.cpulist : "all");
+    fflush(stdout);
+    return;
+  }
+
+  // keep cpus set before if list isn't valid
+  cpu_set_t cpus;
+  enum _bool all = (strcmp(args[1], "all") == 0) ? _true : _false;
+  if (all == _false && parsecpus(args[1], &cpus) == -1) {
+    fprintf(stderr, "bgcpus: %s: not a list of cpus\n", args[1]);
+    return;
+  }
+
+  free(bglimits.cpulist);
+  bglimits.cpulist = NULL;
+  bglimits.pinned = _false;
+  if (all == _false) {
+    bglimits.cpus = cpus;
+    bglimits.cpulist = strdup(args[1]);
+    bglimits.pinned = _true;
+  }
+  updatelimits();
+}
+
+/* ****************************************************************************
+ * Description:
+ * bgulimit command: sets resource limits of background commands, given as
+ * ulimit options such as -v KB or -t seconds. unlimited keeps the shell's
+ * limit. prints the limits that are set with no arguments
+ * @param cmd
+ * ***************************************************************************/
+void _bgulimit(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  int i, j;
+  // print limits
+  if (n < 2) {
+    for (j = 0; j < NRLIMITOPTS; j++) {
+      const struct rlimitopt* opt = &rlimitopts[j];
+      if ((bglimits.rlimset & (1 << opt->resource)) != 0) {
+        printf("-%c %-24s %lu\n", opt->opt, opt->name,
+            (unsigned long) (bglimits.rlim[opt->resource].rlim_cur /
+              opt->unit));
+      }
+    }
+    fflush(stdout);
+    return;
+  }
+
+  for (i = 1; i < n; i += 2) {
+    // find resource of option
+    const struct rlimitopt* opt = NULL;
+    for (j = 0; args[i][0] == '-' && j < NRLIMITOPTS; j++) {
+      if (rlimitopts[j].opt == args[i][1] && args[i][2] == '\0') {
+        opt = &rlimitopts[j];
+      }
+    }
+    if (opt == NULL || i + 1 == n) {
+      fprintf(stderr, "usage: bgulimit [-t|-f|-d|-s|-n|-u|-v value]...\n");
+      return;
+    }
+
+    // set limit, or unset it
+    int bit = 1 << opt->resource;
+    if (strcmp(args[i + 1], UNLIMITED) == 0) {
+      bglimits.rlimset &= ~bit;
+      continue;
+    }
+    char* end;
+    unsigned long value = strtoul(args[i + 1], &end, 10);
+    if (*end != '\0' || end == args[i + 1]) {
+      fprintf(stderr, "bgulimit: %s: not a number\n", args[i + 1]);
+      continue;
+    }
+    bglimits.rlim[opt->resource].rlim_cur = (rlim_t) value * opt->unit;
+    bglimits.rlim[opt->resource].rlim_max = (rlim_t) value * opt->unit;
+    bglimits.rlimset |= bit;
+  }
+  updatelimits();
+}
+
+/* ****************************************************************************
+ * Description:
+ * bgcgroup command: sets the cgroup (v2) directory background commands are
+ * moved into, none to leave them in the shell's. prints it with no arguments
+ * @param cmd
+ * ***************************************************************************/
+void _bgcgroup(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  if (n < 2) {
+    printf("%s\n", bglimits.cgroup != NULL ? bglimits.cgroup : "none");
+    fflush(stdout);
+    return;
+  }
+
+  free(bglimits.cgroup);
+  bglimits.cgroup = NULL;
+  if (strcmp(args[1], "none") != 0) {
+    // check that processes can be moved into cgroup
+    char file[BUFFER];
+    snprintf(file, sizeof(file), "%s/%s", args[1], CGROUP_PROCS);
+    if (access(file, W_OK) == -1) {
+      perror("error: unable to access cgroup");
+    } else {
+      bglimits.cgroup = strdup(args[1]);
+    }
+  }
+  updatelimits();
+}
+
+/* ****************************************************************************
+ * Description:
+ * reads the command lines of fp, skipping blank lines and comments, and
+ * parses each one. lines are copied into the command line arena. returns
+ * malloc'd array of tasks and stores how many there are
+ * @param fp
+ * @param ntasks
+ * ***************************************************************************/
+struct task* readtasks(FILE* fp, int* ntasks) {
+  struct task* tasks = NULL;
+  int n = 0;
+  int size = 0;
+  char* line = NULL;
+  size_t buffer = 0;
+  while (getline(&line, &buffer, fp) != -1) {
+    line[strcspn(line, "\n")] = '\0';
+    char* p = line;
+    while (*p == ' ') p++;
+    if (*p == '\0' || *p == '#') continue;
+
+    // grow array
+    if (n == size) {
+      size = (size == 0) ? 16 : 2 * size;
+      tasks = realloc(tasks, sizeof(struct task) * size);
+    }
+    struct task* task = &tasks[n++];
+    memset(task, 0, sizeof(struct task));
+    task->out = -1;
+    task->status = W_EXITCODE(1, 0);  // until the last command is reaped
+
+    // keep line for summary, parsing slices up a second copy
+    size_t len = strlen(p) + 1;
+    task->cmdline = memcpy(arenaAlloc(&cmdarena, len), p, len);
+    char* input = memcpy(arenaAlloc(&cmdarena, len), p, len);
+    task->cmds = parseInput(&task->n, input);
+
+    // a trailing & means nothing, every command line runs alongside others
+    struct command* last = (task->cmds == NULL) ? NULL :
+        &task->cmds[task->n - 1];
+    if (last != NULL && strcmp(last->args[last->n - 1], "&") == 0) {
+      last->args[--last->n] = NULL;
+      if (last->n == 0 && --task->n == 0) {
+        task->cmds = NULL;
+      }
+    }
+  }
+  free(line);
+  *ntasks = n;
+  return tasks;
+}
+
+/* ****************************************************************************
+ * Description:
+ * returns fd of a new temporary file that's already unlinked, or -1
+ * ***************************************************************************/
+int tmpfd() {
+  const char* dir = getenv(TMPDIR);
+  if (dir == NULL) {
+    dir = DEFTMP;
+  }
+  int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  if (fd != -1) {
+    return fd;
+  }
+
+  // file system doesn't support O_TMPFILE, unlink a named file
+  char name[BUFFER];
+  snprintf(name, sizeof(name), "%s/smallshXXXXXX", dir);
+  fd = mkostemp(name, O_CLOEXEC);
+  if (fd != -1) {
+    unlink(name);
+  }
+  return fd;
+}
+
+/* ****************************************************************************
+ * Description:
+ * writes everything in file fd to stdout
+ * @param fd
+ * ***************************************************************************/
+void copyout(int fd) {
+  char buf[BUFFER];
+  ssize_t len;
+  fflush(stdout);
+  lseek(fd, 0, SEEK_SET);
+  while ((len = read(fd, buf, sizeof(buf))) > 0) {
+    if (write(1, buf, len) != len) {
+      break;
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * parallel command: runs the command lines of a file, or of stdin until EOF,
+ * keeping at most N running at once. each command line's stdout and stderr
+ * go to a temporary file that's printed once it's done, then a summary of
+ * every command line's status is printed. status becomes the number of
+ * command lines that failed
+ * @param cmd: file of command lines may be given with <
+ * ***************************************************************************/
+void _parallel(struct command* cmd) {
+  char** args = cmd->args;
+  int n = cmd->n;
+  // get number of slots and file of command lines
+  long slots = sysconf(_SC_NPROCESSORS_ONLN);
+  char* file = cmd->infile;
+  int i = 1;
+  for (; i < n; i++) {
+    if (strcmp(args[i], "-j") == 0 && i + 1 < n) {
+      slots = atol(args[++i]);
+    } else if (file == NULL && args[i][0] != '-') {
+      file = args[i];
+    } else {
+      fprintf(stderr, "usage: parallel [-j N] [file]\n");
+      return;
+    }
+  }
+  if (slots < 1) {
+    fprintf(stderr, "parallel: -j needs a positive number\n");
+    return;
+  }
+
+  // read command lines
+  FILE* fp = stdin;
+  if (file != NULL && (fp = fopen(file, "r")) == NULL) {
+    perror("error: unable to access file");
+    return;
+  }
+  int ntasks = 0;
+  struct task* tasks = readtasks(fp, &ntasks);
+  if (fp == stdin) {
+    clearerr(stdin);
+  } else {
+    fclose(fp);
+  }
+
+  // commands get no input unless redirected, stdin may hold more commands
+  int devnull = open(DEVNULL, O_RDONLY | O_CLOEXEC);
+
+  int next = 0;     // idx of next task to launch
+  int running = 0;  // number of tasks launched but not done
+  while (next < ntasks || running > 0) {
+    // launch tasks into free slots
+    while (running < slots && next < ntasks) {
+      struct task* task = &tasks[next++];
+      if (task->cmds == NULL) continue;
+      if ((task->out = tmpfd()) == -1) {
+        perror("error: unable to create temporary file");
+        continue;
+      }
+      task->pids = arenaAlloc(&cmdarena, sizeof(pid_t) * task->n);
+      task->live = launchpipeline(task->cmds, task->n, task->pids, devnull,
+          task->out, task->out);
+      if (task->live == 0) {
+        close(task->out);
+        continue;
+      }
+      running++;
+    }
+    if (running == 0) continue;
+
+    // wait for any command
+    int childExitInteger;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &childExitInteger, 0, &usage);
+    if (pid == -1) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    // find task the command belongs to
+    struct task* task = NULL;
+    int j = 0;
+    for (i = 0; i < next && task == NULL; i++) {
+      for (j = 0; tasks[i].live > 0 && j < tasks[i].n; j++) {
+        if (tasks[i].pids[j] == pid) {
+          task = &tasks[i];
+          break;
+        }
+      }
+    }
+
+    // a background job finished, it's reported at the next prompt
+    if (task == NULL) {
+      updatejob(pid, childExitInteger, &usage);
+      continue;
+    }
+
+    if (j == task->n - 1) task->status = childExitInteger;
+    task->pids[j] = 0;
+    if (--task->live == 0) {
+      // print output of the whole command line at once
+      copyout(task->out);
+      close(task->out);
+      running--;
+    }
+  }
+  if (devnull != -1) close(devnull);
+
+  // summary
+  int failed = 0;
+  for (i = 0; i < ntasks; i++) {
+    printf("[%d] %s: ", i + 1, tasks[i].cmdline);
+    showStatus(tasks[i].status);
+    if (!WIFEXITED(tasks[i].status) || WEXITSTATUS(tasks[i].status) != 0) {
+      failed++;
+    }
+  }
+  status = W_EXITCODE(failed > 255 ? 255 : failed, 0);
+  free(tasks);
+}
+
+/* ****************************************************************************
+ * Description:
+ * launches command with posix_spawn() given its location, or posix_spawnp()
+ * when path is NULL. pipes and redirections are done as file actions and
+ * SIGINT is restored to default in the child. returns pid of child or -1 if
+ * it couldn't be spawned, with errno set
+ * @param cmd
+ * @param path
+ * @param in: fd to use as stdin, -1 to keep shell's
+ * @param out: fd to use as stdout, -1 to keep shell's
+ * @param err: fd to use as stderr, -1 to keep shell's
+ * ***************************************************************************/
+pid_t spawnChild(struct command* cmd, char* path, int in, int out, int err) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t sigdefault, sigmask;
+  pid_t pid = -1;
+
+  // handle pipes, then file redirects which take precedence
+  posix_spawn_file_actions_init(&actions);
+  if (in != -1) {
+    posix_spawn_file_actions_adddup2(&actions, in, 0);
+  }
+  if (out != -1) {
+    posix_spawn_file_actions_adddup2(&actions, out, 1);
+  }
+  if (err != -1) {
+    posix_spawn_file_actions_adddup2(&actions, err, 2);
+  }
+  if (cmd->infile != NULL) {
+    posix_spawn_file_actions_addopen(&actions, 0, cmd->infile, O_RDONLY, 0);
+  }
+  if (cmd->outfile != NULL) {
+    posix_spawn_file_actions_addopen(&actions, 1, cmd->outfile,
+        O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+
+  // child takes default action for SIGINT, with no signals blocked
+  posix_spawnattr_init(&attr);
+  sigemptyset(&sigdefault);
+  sigaddset(&sigdefault, SIGINT);
+  sigemptyset(&sigmask);
+  posix_spawnattr_setsigdefault(&attr, &sigdefault);
+  posix_spawnattr_setsigmask(&attr, &sigmask);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF |
+      POSIX_SPAWN_SETSIGMASK);
+
+  // attempt to spawn command
+  int res;
+  char** args = cmd->args;
+  if (path != NULL) {
+    res = posix_spawn(&pid, path, &actions, &attr, args, environ);
+  } else {
+    res = posix_spawnp(&pid, args[0], &actions, &attr, args, environ);
+  }
+  if (res != 0) {
+    pid = -1;
+    errno = res;
+  }
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  return pid;
+}
+
+/* ****************************************************************************
+ * Description:
+ * launches command with fork() and execv() given its location, or execvp()
+ * when path is NULL or doesn't work. returns pid of child. errors opening
+ * files or executing the command are printed by the child, which then exits
+ * with 1
+ * @param cmd
+ * @param path
+ * @param in: fd to use as stdin, -1 to keep shell's
+ * @param out: fd to use as stdout, -1 to keep shell's
+ * @param err: fd to use as stderr, -1 to keep shell's
+ * ***************************************************************************/
+pid_t forkChild(struct command* cmd, char* path, int in, int out, int err) {
+  // create a fork for process
+  pid_t pid = fork();
   switch(pid) {
     case -1:    // check if error creating child
       perror("error: unable to create fork\n");
@@ -344,107 +2347,278 @@ void _fork(char** args, int n, enum _bool bkgd, int* childExitStatus,
       termsig.sa_handler = SIG_DFL;
       sigaction(SIGINT, &termsig, NULL);
 
+      // handle pipes, pipe fds are closed on exec
+      if ((in != -1 && dup2(in, 0) == -1) ||
+          (out != -1 && dup2(out, 1) == -1) ||
+          (err != -1 && dup2(err, 2) == -1)) {
+        perror("error: unable to access pipe");
+        _exit(1);
+      }
+
       // handle file redirects
-      fileDirection(infile, outfile);
+      fileDirection(cmd->infile, cmd->outfile);
+
+      // resource controls of background commands
+      if (childlimits != NULL) {
+        applylimits(childlimits);
+      }
 
       // attempt to execute command, print error if occurs
-      // printargs(args);
-      int exec = execvp(args[0], args);
-      if (exec == -1) {
-        perror("error: invalid command");
-        fflush(stdout);
-        exit(1);
+      // printargs(cmd->args);
+      if (path != NULL) {
+        execv(path, cmd->args);
       }
+      execvp(cmd->args[0], cmd->args);
+      perror("error: invalid command");
+      // _exit so the shell's stdio isn't flushed twice, or a script's read
+      // position moved back by the child closing it
+      _exit(1);
+  }
+  return pid;
+}
+
+/* ****************************************************************************
+ * Description:
+ * launches a command and returns its pid. commands are spawned, falling back
+ * on fork() if spawning fails so the child reports the error the same way
+ * either path is taken. commands with resource controls are always forked,
+ * the child applies them before it execs
+ * @param cmd
+ * @param in: fd to use as stdin, -1 to keep shell's
+ * @param out: fd to use as stdout, -1 to keep shell's
+ * @param err: fd to use as stderr, -1 to keep shell's
+ * ***************************************************************************/
+pid_t launch(struct command* cmd, int in, int out, int err) {
+  // get location of command
+  char* name = cmd->args[0];
+  char* path = commandPath(name);
+
+  // launch child process
+  pid_t pid = -1;
+  if (useSpawn == _true && childlimits == NULL) {
+    pid = spawnChild(cmd, path, in, out, err);
+    // these errors also come from redirect files, so only search PATH again
+    // if the remembered location itself stopped working
+    if (pid == -1 && path != NULL &&
+        (errno == ENOENT || errno == EACCES || errno == ENOEXEC) &&
+        stalePath(name, &path) == _true && path != NULL) {
+      pid = spawnChild(cmd, path, in, out, err);
+    }
+  } else {
+    // a forked child can't report a bad location back, check it here
+    stalePath(name, &path);
+  }
+  if (pid == -1) {
+    pid = forkChild(cmd, path, in, out, err);
+  }
+  return pid;
+}
+
+/* ****************************************************************************
+ * Description:
+ * checks the remembered location of command name. if it can't be executed
+ * anymore it's forgotten, PATH is searched again and path is set to the new
+ * location. returns _true if the location was stale
+ * @param name
+ * @param path: remembered location from commandPath(), NULL if none
+ * ***************************************************************************/
+enum _bool stalePath(const char* name, char** path) {
+  if (*path == NULL || access(*path, X_OK) == 0) {
+    return _false;
+  }
+  hashremove(name);
+  *path = commandPath(name);
+  return _true;
+}
+
+/* ****************************************************************************
+ * Description:
+ * launches the commands of a pipeline, each one reading from the pipe the
+ * previous one writes to, and stores their pids. returns number of commands
+ * launched, which is less than n if a pipe couldn't be made
+ * @param cmds
+ * @param n
+ * @param pids
+ * @param in: fd to use as stdin of first command, -1 to keep shell's
+ * @param out: fd to use as stdout of last command, -1 to keep shell's
+ * @param err: fd to use as stderr of every command, -1 to keep shell's
+ * ***************************************************************************/
+int launchpipeline(struct command* cmds, int n, pid_t* pids, int in,
+    int out, int err) {
+  int prev = in;  // read end of pipe from previous command
+  int i = 0;
+  for (; i < n; i++) {
+    int fds[2] = { -1, out };
+    if (i < n - 1 && pipe2(fds, O_CLOEXEC) == -1) {
+      perror("error: unable to create pipe");
       break;
+    }
+    pids[i] = launch(&cmds[i], prev, fds[1], err);
 
-    default:    // curr is parent process
-      if (bkgd == _true && fgOnly == _false) {          // on background
-        waitpid(pid, childExitStatus, WNOHANG);
-        // print background pid
-        printf("background pid is %d\n", pid);
-        fflush(stdout);
-      } else {  // on foreground
-        // wait for process to finish
-        waitpid(pid, childExitStatus, 0);
-        // check if signal terminated process
-        signalstatus(*childExitStatus);
-      }
-      // run through background processes
-      while ((pid = waitpid(-1, childExitStatus, WNOHANG)) > 0) {
-        printf("background process %d is done: ", pid);
-        showStatus(*childExitStatus);
-        fflush(stdout);
+    // shell keeps no pipe ends, the commands own them now
+    if (i > 0) close(prev);
+    if (i < n - 1) close(fds[1]);
+    prev = fds[0];
+  }
+  if (i > 0 && i < n) close(prev);
+  return i;
+}
+
+/* ****************************************************************************
+ * Description:
+ * launches all other commands and waits for them in the foreground. the
+ * commands of a pipeline are all launched before any is waited for, each
+ * one's output piped to the next, and the status of the last is kept.
+ * the command line becomes a job, which stays in the job table if it's run
+ * in the background or stopped
+ * @param cmds
+ * @param n
+ * @param bkgd
+ * @param timed: report usage of job once it's done
+ * ***************************************************************************/
+void _fork(struct command* cmds, int n, enum _bool bkgd, enum _bool timed) {
+  pid_t* pids = arenaAlloc(&cmdarena, sizeof(pid_t) * n);
+  int i;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // launch each command, background ones with their resource controls
+  if (bkgd == _true && fgOnly == _false && bglimits.set == _true) {
+    childlimits = &bglimits;
+  }
+  n = launchpipeline(cmds, n, pids, -1, -1, -1);
+  childlimits = NULL;
+  if (n == 0) {
+    return;
+  }
+  struct job* job = addjob(cmds, n, pids);
+  if (job != NULL) {
+    job->timed = timed;
+    job->start = start;
+  }
+
+  // curr is parent process
+  if (bkgd == _true && fgOnly == _false) {          // on background
+    // print background pid
+    printf("background pid is %d\n", pids[n - 1]);
+    if (job == NULL) {
+      fprintf(stderr, "error: job table is full, job won't be tracked\n");
+    }
+    fflush(stdout);
+  } else {  // on foreground
+    // wait for every command to finish, keeping status of the last
+    if (job != NULL) {
+      status = waitjob(job);
+    } else {
+      for (i = 0; i < n; i++) {
+        waitpid(pids[i], &status, 0);
       }
+    }
+    // check if signal terminated process
+    signalstatus(status);
   }
+  // run through background processes
+  reapjobs();
 }
 
 /* ****************************************************************************
  * Description:
  * runs shell program and executes user's commands
- * @param args
- * @param n
- * @param infile
- * @param outfile
+ * @param cmds
+ * @param n: number of commands, more than one for a pipeline
  * ***************************************************************************/
-void _runshell(char** args, int n, char* infile, char* outfile) {
+void _runshell(struct command* cmds, int n) {
   // check for invalid arguments
-  if (args == NULL || n < 1) {
+  if (cmds == NULL || n < 1) {
     return;
   }
 
   enum _bool bkgd = _false; // track if background process
-  static int status = 0;    // status code
 
   // check if background process and if it can be background process
-  if (strcmp(args[n - 1], "&") == 0) {
+  struct command* last = &cmds[n - 1];
+  if (strcmp(last->args[last->n - 1], "&") == 0) {
     if (fgOnly == _false) {
       bkgd = _true;   // if so, assign it to background
     }
-    free(args[n - 1]);  // remove last argument: "&" for remainder of this run 
-    args[--n] = NULL;
+    // remove last argument: "&" for remainder of this run
+    last->args[--last->n] = NULL;
+    if (last->n == 0) {
+      n--;
+      if (n == 0) return;
+    }
   }
 
-  // check if executed is a supported commands
-  char* cmd = args[0];
-
-  // exit command
-  if (strcmp(cmd, EXIT) == 0) {
-    // exit status 0
-    exit(0);
+  // time prefix applies to the rest of the command line
+  enum _bool timed = _false;
+  if (strcmp(cmds[0].args[0], TIME) == 0 && cmds[0].n > 1) {
+    timed = _true;
+    cmds[0].args++;
+    cmds[0].n--;
   }
 
-  // cd command
-  if (strcmp(cmd, CD) == 0) {
-    // change directory
-    _chdir(args, n);  // chdir command
-    return;
-  } 
-
-  // status command
-  if (strcmp(cmd, STATUS) == 0) {
-    showStatus(status);
-    return;
-  } 
+  // builtins run in the shell, they aren't part of a pipeline
+  if (n == 1) {
+    const struct builtin* builtin = findbuiltin(cmds[0].args[0]);
+    if (builtin != NULL && (bkgd == _false || builtin->inbkgd == _true)) {
+      if (timed == _true) {
+        timebuiltin(builtin, &cmds[0]);
+      } else {
+        runbuiltin(builtin, &cmds[0]);
+      }
+      return;
+    }
+  }
 
   // all other commands induces fork()
-  _fork(args, n, bkgd, &status, infile, outfile);
+  _fork(cmds, n, bkgd, timed);
 }
 
 /* ****************************************************************************
- * Description: frees args 
- * @param args
+ * Description:
+ * returns n bytes from arena, adding a block when the current one is full
+ * @param arena
  * @param n
  * ***************************************************************************/
-void freeargs(char** args, int n) {
-  // free each string
-  int i = 0;
-  for (; i < n; i++) {
-    free(args[i]);
-    args[i] = NULL;
+void* arenaAlloc(struct arena* arena, size_t n) {
+  n = (n + sizeof(void*) - 1) & ~(sizeof(void*) - 1);  // keep pointers aligned
+
+  struct arenablock* block = arena->head;
+  if (block == NULL || block->used + n > block->size) {
+    size_t size = (n > ARENASIZE) ? n : ARENASIZE;
+    block = malloc(sizeof(struct arenablock) + size);
+    if (block == NULL) {
+      perror("error: unable to allocate memory");
+      exit(1);
+    }
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+  }
+
+  void* p = block->data + block->used;
+  block->used += n;
+  return p;
+}
+
+/* ****************************************************************************
+ * Description:
+ * hands all of arena's memory back at once. the newest block is kept for the
+ * next command line, any others are freed
+ * @param arena
+ * ***************************************************************************/
+void arenaReset(struct arena* arena) {
+  struct arenablock* block = arena->head;
+  if (block == NULL) {
+    return;
+  }
+  while (block->next != NULL) {
+    struct arenablock* next = block->next->next;
+    free(block->next);
+    block->next = next;
   }
-  // free the pointer to the array of strings
-  free(args);
-  args = NULL;
+  block->used = 0;
 }
 
 /* ****************************************************************************
@@ -463,8 +2637,42 @@ void printargs(char** args) {
 /* ****************************************************************************
  * main program
  * ***************************************************************************/
-int main() {
+int main(int argc, char** argv) {
+  // get where command lines come from
+  cmdfile = stdin;
+  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    if (argc < 3) {
+      fprintf(stderr, "usage: smallsh [-c cmds | file]\n");
+      exit(2);
+    }
+    cmdfile = fmemopen(argv[2], strlen(argv[2]), "r");
+    prompt = _false;
+  } else if (argc > 1) {
+    cmdfile = fopen(argv[1], "re");
+    prompt = _false;
+  }
+  if (cmdfile == NULL) {
+    perror("error: unable to access file");
+    exit(1);
+  }
+
+  // read input that isn't typed in large blocks
+  if (!isatty(fileno(cmdfile))) {
+    interactive = _false;
+    setvbuf(cmdfile, NULL, _IOFBF, INPUTSIZE);
+  }
+
   catchSignal();    // handle signals
+  initbuiltins();
+
+  // select launch path
+  char* launch = getenv(LAUNCH_ENV);
+  if (launch != NULL && strcmp(launch, LAUNCH_FORK) == 0) {
+    useSpawn = _false;
+  }
+
+  // expansion of PIDVAR
+  sprintf(pidstr, "%d", getpid());
 
   // buffer allocated by getline() that holds our entered string + \n + \0
   char* input = NULL; 
@@ -479,24 +2687,14 @@ int main() {
     if (input[0] == '\0') continue;
 
     // parse command
-    int nArgs = 0;
-    char* infile = malloc(sizeof(char) * BUFFER);
-    memset(infile, sizeof(infile), '\0');
-    char* outfile = malloc(sizeof(char) * BUFFER);
-    memset(outfile, sizeof(outfile), '\0' );
-    char** args = parseInput(&nArgs, input, infile, outfile);
+    int nCmds = 0;
+    struct command* cmds = parseInput(&nCmds, input);
 
     // execute shell
-    _runshell(args, nArgs, infile, outfile);
-
-    // Free the memory allocated or else memory leak
-    free(infile);
-    free(outfile);
-    free(input);
-    infile = NULL;
-    outfile = NULL;
-    input = NULL;
-    freeargs(args, ARGBUFF);
+    _runshell(cmds, nCmds);
+
+    // hand back memory used by the command line
+    arenaReset(&cmdarena);
   }
 
   return 0;
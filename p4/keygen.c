@@ -4,50 +4,40 @@
  * Description: keygen.c
  * This program creates and prints a key of a specified length (given as an 
  * argument). The chars generated include uppercase alphas and space char.
+ * Keys are drawn from the kernel's CSPRNG through genkey() in otp.c.
+ * With -b a binary key of random bytes is written instead, for use with the
+ * binary mode of otp_enc/otp_dec:
+ *    keygen length [-b]
  * **************************************************************************/
 
+#include "otp.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <time.h>
 
 int main(int argc, char* argv[]) {
   // print error if argument is not provided
   if (argv[1] == 0) {
     printf("error: please indicate length of keygen to be generated\n");
-    printf("command use:  keygen length\n");
+    printf("command use:  keygen length [-b]\n");
     return 0;
   }
 
-  // seed based on current time
-  srand(time(0));
-
-  // get keylen
+  // get keylen and mode
   int keylen = atoi(argv[1]);
-  char key[keylen + 1];
-
-  int i = 0;
-  for (; i < keylen; i++) {
-    // generate random letter
-    char ch = ' ';  // initialize character as white space
-    //              // will remain if random num generated == 26
-
-    // generate random number to determine if ch is uppercase alpha
-    int r = (random() % 27);  // random num btwm 0 and 26 (inclusive)
-
-    // determine if random letter is alpha
-    if (r != 26) {
-      ch = 'A' + r;
-    }
-
-    // append key with the generated letter
-    key[i] = ch;
+  int flags = (argc > 2 && strcmp(argv[2], "-b") == 0) ? FLAG_BIN : 0;
+
+  // generate key from the CSPRNG the daemons use, a block at a time
+  char key[BUFFER];
+  while (keylen > 0) {
+    int n = keylen < BUFFER ? keylen : BUFFER;
+    genkey(key, n, flags);
+    fwrite(key, 1, n, stdout);
+    keylen -= n;
   }
 
-  // add null terminator at end
-  key[keylen] = '\0';
-
-  printf("%s\n", key);
+  // text keys end with a newline
+  if ((flags & FLAG_BIN) == 0) printf("\n");
 
   return 0;
 }
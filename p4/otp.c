@@ -6,17 +6,37 @@
  *    otp_enc,  
  *    otp_enc_d,
  *    otp_dec,
- *    otp_dec_d
+ *    otp_dec_d,
+ *    otp_d
  * **************************************************************************/
 #include "otp.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
+#include <endian.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/random.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// crc32c (castagnoli) polynomial, reflected
+#define CRC32C_POLY 0x82F63B78
 
 #define BUFFER 2048
 #define HOST "localhost"
@@ -39,6 +59,135 @@ char valtoch(int val) {
   return (char) (val % 27 + 'A');
 }
 
+/* ****************************************************************************
+ * Description:
+ * fills buffer with n bytes from the kernel's CSPRNG
+ * @param buffer
+ * @param n
+ * ***************************************************************************/
+void randomBytes(char* buffer, size_t n) {
+  size_t got = 0;
+  while (got < n) {
+    ssize_t r = getrandom(buffer + got, n - got, 0);
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0) error("error: unable to get random bytes", 1);
+    got += r;
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * generates a key of n symbols. a binary key is n random bytes, a text key
+ * uses uppercase alphas and space, drawn from random bytes below the largest
+ * multiple of 27 so every symbol is equally likely
+ * @param key
+ * @param n
+ * @param flags
+ * ***************************************************************************/
+void genkey(char* key, size_t n, int flags) {
+  if (flags & FLAG_BIN) {
+    randomBytes(key, n);
+    return;
+  }
+
+  unsigned char block[BUFFER];
+  size_t i = 0;
+  while (i < n) {
+    randomBytes((char*) block, sizeof(block));
+    size_t j = 0;
+    for (; j < sizeof(block) && i < n; j++) {
+      if (block[j] < 27 * 9) key[i++] = valtoch(block[j] % 27);
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * encrypts text considering OTP
+ * @param text
+ * @param key
+ * @param n
+ * ***************************************************************************/
+void encrypt(char* text, const char* key, size_t n) {
+  size_t i = 0;
+  for (; i < n; i++) {
+    int val = chtoval(text[i]) + chtoval(key[i]);
+    text[i] = valtoch(val);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * decrypts text considering OTP
+ * @param text
+ * @param key
+ * @param n
+ * ***************************************************************************/
+void decrypt(char* text, const char* key, size_t n) {
+  size_t i = 0;
+  for (; i < n; i++) {
+    int val = (chtoval(text[i]) - chtoval(key[i]));
+    // check if value is neg
+    if (val < 0) val += 27;
+
+    text[i] = valtoch(val);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * binary OTP, xors every byte of text with key. the same call encrypts and
+ * decrypts. bytes are handled a full vector register at a time where the
+ * target supports it, the tail is done bytewise
+ * @param text
+ * @param key
+ * @param n
+ * ***************************************************************************/
+void xorpad(char* text, const char* key, size_t n) {
+  size_t i = 0;
+#ifdef __AVX2__
+  for (; i + 32 <= n; i += 32) {
+    __m256i t = _mm256_loadu_si256((const __m256i*)(text + i));
+    __m256i k = _mm256_loadu_si256((const __m256i*)(key + i));
+    _mm256_storeu_si256((__m256i*)(text + i), _mm256_xor_si256(t, k));
+  }
+#endif
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    __m128i t = _mm_loadu_si128((const __m128i*)(text + i));
+    __m128i k = _mm_loadu_si128((const __m128i*)(key + i));
+    _mm_storeu_si128((__m128i*)(text + i), _mm_xor_si128(t, k));
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    uint64_t t, k;
+    memcpy(&t, text + i, 8);
+    memcpy(&k, key + i, 8);
+    t ^= k;
+    memcpy(text + i, &t, 8);
+  }
+  for (; i < n; i++) text[i] ^= key[i];
+}
+
+/* ****************************************************************************
+ * Description:
+ * applies the transform selected by mode and flags to text in place
+ * @param mode
+ * @param flags
+ * @param text
+ * @param key
+ * @param n
+ * ***************************************************************************/
+void transform(int mode, int flags, char* text, const char* key, size_t n) {
+  if (flags & FLAG_BIN) {
+    xorpad(text, key, n);
+  } else if (mode == MODE_ENC) {
+    encrypt(text, key, n);
+  } else {
+    decrypt(text, key, n);
+  }
+}
+
 /* ****************************************************************************
  * Description:
  * send message through socket, using send() 
@@ -75,6 +224,153 @@ int recvMessage(char* buffer, int n, int socketFD) {
   return charsRead;
 }
 
+/* ****************************************************************************
+ * crc32c: the sse4.2 crc32 instruction computes it 8 bytes at a time, a
+ * table-driven version is used where the cpu doesn't have it
+ * ***************************************************************************/
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+// builds the byte-at-a-time table for the software crc32c
+static void crcTableInit() {
+  uint32_t i = 0;
+  for (; i < 256; i++) {
+    uint32_t crc = i;
+    int j = 0;
+    for (; j < 8; j++) crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+    crcTable[i] = crc;
+  }
+}
+
+// software crc32c over buffer, crc is the running (inverted) value
+static uint32_t crc32cSoft(uint32_t crc, const char* buffer, size_t n) {
+  pthread_once(&crcOnce, crcTableInit);
+  const unsigned char* p = (const unsigned char*) buffer;
+  while (n--) crc = crcTable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+// hardware crc32c over buffer, crc is the running (inverted) value
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHard(uint32_t crc, const char* buffer, size_t n) {
+  uint64_t crc64 = crc;
+  for (; n >= 8; n -= 8, buffer += 8) {
+    uint64_t word;
+    memcpy(&word, buffer, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = (uint32_t) crc64;
+  for (; n > 0; n--, buffer++) crc = _mm_crc32_u8(crc, *buffer);
+  return crc;
+}
+#endif
+
+/* ****************************************************************************
+ * Description:
+ * returns crc32c of buffer continuing from crc, start with crc = 0
+ * @param crc
+ * @param buffer
+ * @param n
+ * ***************************************************************************/
+uint32_t crc32c(uint32_t crc, const char* buffer, size_t n) {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2"))
+    return ~crc32cHard(~crc, buffer, n);
+#endif
+  return ~crc32cSoft(~crc, buffer, n);
+}
+
+/* ****************************************************************************
+ * Description:
+ * send a frame: 8 byte big-endian length followed by the payload. looping
+ * send() so payloads of any size and content go through. with FLAG_CRC the
+ * payload is followed by its 4 byte big-endian crc32c
+ * @param buffer
+ * @param n
+ * @param flags
+ * @param socketFD
+ * ***************************************************************************/
+void sendFrame(const char* buffer, size_t n, int flags, int socketFD) {
+  uint64_t len = htobe64((uint64_t) n);
+  if (send(socketFD, &len, sizeof(len), MSG_MORE) != sizeof(len))
+    error("error: unable to write to socket", 1);
+
+  int more = (flags & FLAG_CRC) ? MSG_MORE : 0;
+  size_t sent = 0;
+  while (sent < n) {
+    ssize_t charsWritten = send(socketFD, buffer + sent, n - sent, more);
+    if (charsWritten < 0) error("error: unable to write to socket", 1);
+    sent += charsWritten;
+  }
+
+  if (flags & FLAG_CRC) {
+    uint32_t crc = htobe32(crc32c(0, buffer, n));
+    if (send(socketFD, &crc, sizeof(crc), 0) != sizeof(crc))
+      error("error: unable to write to socket", 1);
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * read exactly n bytes from socket, returns number of bytes read which is
+ * less than n only if the peer closed the connection
+ * @param buffer
+ * @param n
+ * @param socketFD
+ * ***************************************************************************/
+static size_t recvAll(char* buffer, size_t n, int socketFD) {
+  size_t got = 0;
+  while (got < n) {
+    ssize_t charsRead = recv(socketFD, buffer + got, n - got, 0);
+    if (charsRead < 0) error("error: unable to read from socket", 1);
+    if (charsRead == 0) break;
+    got += charsRead;
+  }
+  return got;
+}
+
+/* ****************************************************************************
+ * Description:
+ * receive a frame sent by sendFrame(). returns a malloc'd buffer, with a \0
+ * after the payload so text can still be handled as a string. exits with
+ * error, closing the connection, if the length is over MAX_FRAME, the frame
+ * is cut short or, with FLAG_CRC, it fails its checksum
+ * @param n: set to payload length
+ * @param flags
+ * @param socketFD
+ * ***************************************************************************/
+char* recvFrame(size_t* n, int flags, int socketFD) {
+  uint64_t len;
+  if (recvAll((char*)&len, sizeof(len), socketFD) != sizeof(len))
+    error("error: connection closed before frame", 1);
+  len = be64toh(len);
+  // length comes from the peer, check it before allocating len + 1 bytes
+  if (len > MAX_FRAME || len > SIZE_MAX - 1) {
+    fprintf(stderr, "error: frame of %llu bytes is too large\n",
+      (unsigned long long) len);
+    exit(1);
+  }
+  *n = (size_t) len;
+
+  char* buffer = malloc(*n + 1);
+  if (buffer == NULL) error("error: unable to allocate frame", 1);
+  if (recvAll(buffer, *n, socketFD) != *n)
+    error("error: connection closed mid-frame", 1);
+  buffer[*n] = '\0';
+
+  if (flags & FLAG_CRC) {
+    uint32_t crc;
+    if (recvAll((char*)&crc, sizeof(crc), socketFD) != sizeof(crc))
+      error("error: connection closed mid-frame", 1);
+    if (be32toh(crc) != crc32c(0, buffer, *n)) {
+      fprintf(stderr, "error: frame failed crc32c check\n");
+      exit(1);
+    }
+  }
+  return buffer;
+}
+
 /* ****************************************************************************
  * Description:
  * attempts to connect to socket, exit with error if occurs
@@ -88,6 +384,450 @@ void socketConnect(int socketFD, struct sockaddr_in* serverAddress) {
   if (stat < 0) { error("error: unable to connect", 0); }
 }
 
+/* ****************************************************************************
+ * Description:
+ * sets options given by optional arguments starting at argv[first],
+ * returns -1 if an argument isn't recognized and 0 otherwise
+ *    -b    binary mode, arbitrary bytes xored with key
+ *    -j N  split text over N concurrent connections
+ *    -g    daemon generates the key, which is written to the key file
+ *    -c    every frame carries a crc32c that both sides verify
+ * @param argc
+ * @param argv
+ * @param first
+ * @param opts
+ * ***************************************************************************/
+int parseOptions(int argc, char** argv, int first, struct options* opts) {
+  opts->flags = 0;
+  opts->stripes = 1;
+
+  int i = first;
+  for (; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0) {
+      opts->flags |= FLAG_BIN;
+    } else if (strcmp(argv[i], "-g") == 0) {
+      opts->flags |= FLAG_GEN;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      opts->flags |= FLAG_CRC;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      opts->stripes = atoi(argv[++i]);
+      if (opts->stripes < 1 || opts->stripes > MAX_STRIPES) return -1;
+    } else {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* ****************************************************************************
+ * Description:
+ * exits with error unless text contains valid characters only
+ * valid characters include:
+ *    space
+ *    uppercase alphas
+ * @param text
+ * @param n
+ * @param filename
+ * ***************************************************************************/
+void validateText(const char* text, size_t n, const char* filename) {
+  size_t i = 0;
+  for (; i < n; i++) {
+    char ch = text[i];
+    // if not space nor uppercase alpha
+    if (ch != ' ' && isupper(ch) == 0) {
+      fprintf(stderr, "error: file \'%s\' contains invalid characters", filename);
+      exit(1);   // result: invalid
+    }
+  }
+}
+
+/* ****************************************************************************
+ * Description:
+ * reads whole file into a malloc'd buffer and returns it. in text mode the
+ * text ends at the first \n and is validated, in binary mode every byte is
+ * kept as is
+ * @param filename
+ * @param n: set to length of text
+ * @param flags
+ * ***************************************************************************/
+char* readfromfile(const char* filename, size_t* n, int flags) {
+  FILE* fi = fopen(filename, "rb");
+  if (fi == NULL) error("error: unable to open text file", 1);
+
+  // read file in chunks, growing buffer as needed
+  size_t cap = BUFFER;
+  size_t len = 0;
+  char* buffer = malloc(cap + 1);
+  while (buffer != NULL) {
+    len += fread(buffer + len, 1, cap - len, fi);
+    if (len < cap) break;
+    cap *= 2;
+    buffer = realloc(buffer, cap + 1);
+  }
+  if (buffer == NULL) error("error: unable to allocate text buffer", 1);
+  if (ferror(fi)) error("error: unable to read text file", 1);
+  fclose(fi);  // close file
+  buffer[len] = '\0';
+
+  if ((flags & FLAG_BIN) == 0) {
+    // remove trailing \n, validate text contains valid characters
+    len = strcspn(buffer, "\n");
+    buffer[len] = '\0';
+    validateText(buffer, len, filename);
+  }
+
+  *n = len;
+  return buffer;
+}
+
+/* ****************************************************************************
+ *  Description:
+ *  validates connection is allowed. the tag is followed by the options the
+ *  request needs, e.g. "otp_enc bin"
+ *  @param tag
+ *  @param flags
+ *  @param socketFD
+ * ***************************************************************************/
+void validateConnection(const char* tag, int flags, int socketFD) {
+  char buffer[BUFFER];
+  memset(buffer, '\0', sizeof(buffer));
+
+  // send this program's tag and options to server
+  strcpy(buffer, tag);
+  if (flags & FLAG_BIN) strcat(buffer, " " BIN_OPT);
+  if (flags & FLAG_GEN) strcat(buffer, " " GEN_OPT);
+  if (flags & FLAG_CRC) strcat(buffer, " " CRC_OPT);
+  sendMessage(buffer, socketFD);
+
+  // get server's response
+  recvMessage(buffer, sizeof(buffer), socketFD);
+
+  // check if accepted, print error if not
+  if (strcmp(buffer, ACCEPT) != 0)
+    error("error: client unable to connect to server", 2);
+}
+
+/* ****************************************************************************
+ * Description:
+ * sets serverAddress to HOST on port. gethostbyname() returns a shared static
+ * result, so this is called once before any stripe threads start
+ * @param port
+ * @param serverAddress
+ * ***************************************************************************/
+void resolveHost(int port, struct sockaddr_in* serverAddress) {
+  memset((char*)serverAddress, '\0', sizeof(*serverAddress)); // clear struct
+  struct hostent* serverHostInfo;
+  // set up address struct
+  serverAddress->sin_family = AF_INET;  // create network-capable socket
+  serverAddress->sin_port = htons(port);  // store port number
+  serverHostInfo = gethostbyname(HOST); // convert machine name to special form
+  // print error if occurs
+  if (serverHostInfo == NULL) error("error: client unable to find host", 1);
+  // copy the address
+  memcpy((char*)&serverAddress->sin_addr.s_addr, (char*)serverHostInfo->h_addr,
+      serverHostInfo->h_length);
+}
+
+/* ****************************************************************************
+ * Description:
+ * opens a socket connected to serverAddress, returns the socket
+ * @param serverAddress: from resolveHost()
+ * ***************************************************************************/
+int clientConnect(const struct sockaddr_in* serverAddress) {
+  struct sockaddr_in addr = *serverAddress;   // socketConnect() takes a copy
+
+  // set up the socket w/ capabilities of full-size socket
+  int socketFD = socket(AF_INET, SOCK_STREAM, 0); // create socket
+  if (socketFD < 0) error("error: client unable to open socket", 1);
+
+  // connect to server
+  socketConnect(socketFD, &addr);
+  return socketFD;
+}
+
+/* ****************************************************************************
+ * Description:
+ * sends one stripe over its own connection and replaces its text with the
+ * transformed text the daemon returns. for FLAG_GEN only the text is sent and
+ * the key the daemon generated is received after it. run as a thread for
+ * striped requests
+ * @param arg: struct stripe
+ * ***************************************************************************/
+void* transferStripe(void* arg) {
+  struct stripe* s = (struct stripe*) arg;
+
+  // connect and validate connection
+  int socketFD = clientConnect(s->addr);
+  validateConnection(s->tag, s->flags, socketFD);
+
+  // send text and the part of the key that's used
+  sendFrame(s->text, s->n, s->flags, socketFD);
+  if ((s->flags & FLAG_GEN) == 0) sendFrame(s->key, s->n, s->flags, socketFD);
+
+  // receive transformed text in place of the sent text
+  size_t n;
+  char* result = recvFrame(&n, s->flags, socketFD);
+  if (n != s->n) error("error: daemon returned wrong length", 1);
+  memcpy(s->text, result, n);
+  free(result);
+
+  // receive generated key
+  if (s->flags & FLAG_GEN) {
+    result = recvFrame(&n, s->flags, socketFD);
+    if (n != s->n) error("error: daemon returned wrong length", 1);
+    memcpy(s->key, result, n);
+    free(result);
+  }
+
+  // close the socket
+  close(socketFD);
+  return NULL;
+}
+
+/* ****************************************************************************
+ * Description:
+ * client program: reads text and key, has the daemon on port transform the
+ * text and prints the result. a large text is split into contiguous stripes
+ * sent over concurrent connections, the results land back in order since
+ * each stripe is transformed in place. with FLAG_GEN the key file is written
+ * with the key the daemon generated instead of read
+ * @param tag
+ * @param textfile
+ * @param keyfile
+ * @param port
+ * @param opts
+ * ***************************************************************************/
+void runClient(const char* tag, const char* textfile, const char* keyfile,
+    int port, const struct options* opts) {
+  int flags = opts->flags;
+
+  // only encryption can use a fresh key
+  if ((flags & FLAG_GEN) && strcmp(tag, ENC_TAG) != 0) {
+    fprintf(stderr, "error: only %s can have the key generated\n", ENC_TAG);
+    exit(1);
+  }
+
+  // get text and key from files, or make room for the generated key
+  size_t n, k;
+  char* text = readfromfile(textfile, &n, flags);
+  char* key;
+  if (flags & FLAG_GEN) {
+    key = malloc(n + 1);
+    if (key == NULL) error("error: unable to allocate key buffer", 1);
+    k = n;
+  } else {
+    key = readfromfile(keyfile, &k, flags);
+  }
+
+  // check if key is long enough, exit as reqd
+  if (n > k) { 
+    fprintf(stderr, "error: key \'%s\' is too short\n", keyfile); 
+    exit(1); 
+  }
+
+  // don't split text into stripes smaller than MIN_STRIPE
+  size_t stripes = opts->stripes;
+  if (stripes > n / MIN_STRIPE) stripes = n / MIN_STRIPE;
+  if (stripes < 1) stripes = 1;
+  if ((n + stripes - 1) / stripes > MAX_FRAME) {
+    fprintf(stderr, "error: \'%s\' is too large, split it with -j\n",
+      textfile);
+    exit(1);
+  }
+
+  // resolve daemon address once, stripe threads share it
+  struct sockaddr_in serverAddress;
+  resolveHost(port, &serverAddress);
+
+  // split text into contiguous stripes, the first n % stripes get a byte more
+  struct stripe s[MAX_STRIPES];
+  pthread_t threads[MAX_STRIPES];
+  size_t off = 0;
+  size_t i = 0;
+  for (; i < stripes; i++) {
+    size_t len = n / stripes + (i < n % stripes ? 1 : 0);
+    struct stripe st = { tag, flags, &serverAddress, text + off, key + off,
+      len };
+    s[i] = st;
+    off += len;
+  }
+
+  // transfer stripes concurrently, the first on this thread
+  for (i = 1; i < stripes; i++) {
+    if (pthread_create(&threads[i], NULL, transferStripe, &s[i]) != 0)
+      error("error: unable to create thread", 1);
+  }
+  transferStripe(&s[0]);
+  for (i = 1; i < stripes; i++) pthread_join(threads[i], NULL);
+
+  // save generated key in the same format keygen writes
+  if (flags & FLAG_GEN) {
+    FILE* fo = fopen(keyfile, "wb");
+    if (fo == NULL) error("error: unable to open key file", 1);
+    fwrite(key, 1, n, fo);
+    if ((flags & FLAG_BIN) == 0) fputc('\n', fo);
+    if (fclose(fo) != 0) error("error: unable to write key file", 1);
+  }
+
+  // print transformed text
+  if (flags & FLAG_BIN) {
+    fwrite(text, 1, n, stdout);
+  } else {
+    printf("%s\n", text);
+  }
+
+  free(text);
+  free(key);
+}
+
+/* ****************************************************************************
+ * Description:
+ * authenticates if connection can be made. the client's tag selects the
+ * transform for this request, returns MODE_ENC or MODE_DEC. the options that
+ * follow the tag are returned through flags. a tag this daemon does not serve
+ * is rejected and the child exits
+ * @param modes
+ * @param flags
+ * @param socketFD
+ * ***************************************************************************/
+int authenticateConnection(int modes, int* flags, int socketFD) {
+  char buffer[BUFFER];
+  memset(buffer, '\0', sizeof(buffer));
+
+  // receive validation message from client
+  recvMessage(buffer, sizeof(buffer), socketFD);
+
+  // determine requested mode from tag
+  int mode = 0;
+  char* save = NULL;
+  char* token = strtok_r(buffer, " ", &save);
+  if (token != NULL && strcmp(token, ENC_TAG) == 0) mode = MODE_ENC;
+  if (token != NULL && strcmp(token, DEC_TAG) == 0) mode = MODE_DEC;
+
+  // determine request options
+  *flags = 0;
+  while (mode != 0 && (token = strtok_r(NULL, " ", &save)) != NULL) {
+    if (strcmp(token, BIN_OPT) == 0) {
+      *flags |= FLAG_BIN;
+    } else if (strcmp(token, GEN_OPT) == 0 && mode == MODE_ENC) {
+      *flags |= FLAG_GEN;
+    } else if (strcmp(token, CRC_OPT) == 0) {
+      *flags |= FLAG_CRC;
+    } else {
+      mode = 0;   // unknown option
+    }
+  }
+
+  // reject if tag is unknown or not served by this daemon
+  if ((mode & modes) == 0) {
+    sendMessage(REJECT, socketFD);
+    error("error: attempt to connect terminated", 2);
+  }
+
+  // authenticate by sending acceptance
+  sendMessage(ACCEPT, socketFD);
+  return mode;
+}
+
+/* ****************************************************************************
+ * Description:
+ * handles a single client request: get text/key, send back transformed text
+ * @param modes
+ * @param socketFD
+ * ***************************************************************************/
+void serveConnection(int modes, int socketFD) {
+  // authenticate client, tag and options decide the transform
+  int flags;
+  int mode = authenticateConnection(modes, &flags, socketFD);
+
+  // read text and key, or generate a key for the text
+  size_t n, k;
+  char* text = recvFrame(&n, flags, socketFD);
+  char* key;
+  if (flags & FLAG_GEN) {
+    key = malloc(n + 1);
+    if (key == NULL) error("error: unable to allocate key", 1);
+    genkey(key, n, flags);
+    k = n;
+  } else {
+    key = recvFrame(&k, flags, socketFD);
+  }
+  if (k < n) error("error: key is too short", 1);
+
+  // transform text, write it to socket followed by a generated key
+  transform(mode, flags, text, key, n);
+  sendFrame(text, n, flags, socketFD);
+  if (flags & FLAG_GEN) sendFrame(key, n, flags, socketFD);
+
+  free(text);
+  free(key);
+}
+
+/* ****************************************************************************
+ * Description:
+ * listens on port and forks a child per connection. every child is served
+ * from the same process tree, whichever transform it requests
+ * @param port
+ * @param modes
+ * ***************************************************************************/
+void runDaemon(int port, int modes) {
+  socklen_t sizeOfClientInfo;
+
+  // set up address struct for process
+  struct sockaddr_in serverAddress, clientAddress;
+  memset((char *)&serverAddress, '\0', sizeof(serverAddress)); // Clear address
+
+  serverAddress.sin_family = AF_INET; // Create a network-capable socket
+  serverAddress.sin_port = htons(port); // Store the port number
+  serverAddress.sin_addr.s_addr = INADDR_ANY; // Any address is allowed for connection to this process
+
+  // set up socket
+  int listenSocketFD, establishedConnectionFD;  
+  listenSocketFD = socket(AF_INET, SOCK_STREAM, 0); // create socket
+  if (listenSocketFD < 0) error("error: server unable to open socket", 1);
+
+  // enable socket to begin listening
+  // Connect socket to port
+  if (bind(listenSocketFD, (struct sockaddr *)&serverAddress, 
+        sizeof(serverAddress)) < 0) 
+    error("error: server unable to bind", 1);
+
+  // Flip the socket on - queue enough connections for a striped request
+  if (listen(listenSocketFD, BACKLOG) < 0) 
+    error("error: server unable to listen", 1);
+
+  // wait for connection request from client
+  int status = -5;
+  while (1) {
+    // accept connection, blocking if one isn't available until one connects
+    sizeOfClientInfo = sizeof(clientAddress); // Get the size of the address 
+    establishedConnectionFD = accept(listenSocketFD, 
+        (struct sockaddr*)&clientAddress, &sizeOfClientInfo);  // accept
+    if (establishedConnectionFD < 0) 
+      error("error: server unable to accept", 1);
+
+    // fork request
+    pid_t pid = fork();
+    switch (pid) {
+      case -1:  // error 
+        error("error: server unable to create fork", 1);
+        break;
+      case 0:  // successful: get text/key from client, send result
+        close(listenSocketFD);
+        serveConnection(modes, establishedConnectionFD);
+        close(establishedConnectionFD); // Close the existing socket which is connected to the client
+        exit(0);
+      default:  // parent process
+        close(establishedConnectionFD);
+        while (pid > 0) {
+          pid = waitpid(-1, &status, WNOHANG);
+        }
+        break;
+    }
+  }
+  close(listenSocketFD); // Close the listening socket
+}
+
 /* ****************************************************************************
  * Description:
  * print error message and exit
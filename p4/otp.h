@@ -6,12 +6,14 @@
  *    otp_enc,  
  *    otp_enc_d,
  *    otp_dec,
- *    otp_dec_d
+ *    otp_dec_d,
+ *    otp_d
  * **************************************************************************/
 #ifndef OTP_H
 #define OTP_H 
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -25,19 +27,84 @@
 // connection validity
 #define ACCEPT "accepted"
 #define REJECT "rejected"
+// daemon modes, a daemon serves every tag whose mode bit is set
+#define MODE_ENC 0x1
+#define MODE_DEC 0x2
+#define MAX_CONNECTIONS 5
+// request options, sent after the tag in the handshake
+#define BIN_OPT "bin"
+#define GEN_OPT "gen"
+#define CRC_OPT "crc"
+#define FLAG_BIN 0x1
+#define FLAG_GEN 0x2    // daemon generates the key and returns it
+#define FLAG_CRC 0x4    // every frame carries a CRC32C trailer
+// striping, a large text is split over up to MAX_STRIPES connections of at
+// least MIN_STRIPE bytes each
+#define MAX_STRIPES 64
+#define MIN_STRIPE 65536
+// largest payload a frame may carry, a peer's length is checked against it
+// before anything is allocated for the frame
+#define MAX_FRAME ((uint64_t) 1 << 30)
+// pending connections a daemon queues, enough for every stripe of a request
+#define BACKLOG (MAX_CONNECTIONS + MAX_STRIPES)
+
+// client options given on the command line
+struct options {
+  int flags;    // FLAG_* options sent in the handshake
+  int stripes;  // number of concurrent connections
+};
+
+// one contiguous segment of a request, sent over its own connection
+struct stripe {
+  const char* tag;
+  int flags;
+  const struct sockaddr_in* addr;   // daemon, resolved once for all stripes
+  char* text;   // segment of text, replaced by the result
+  char* key;    // segment of key, filled in by the daemon for FLAG_GEN
+  size_t n;
+};
 
 // character int conversion
 int chtoval(char);
 char valtoch(int);
 
+// key generation
+void randomBytes(char*, size_t);
+void genkey(char*, size_t, int);
+
+// otp transforms
+void encrypt(char*, const char*, size_t);
+void decrypt(char*, const char*, size_t);
+void xorpad(char*, const char*, size_t);
+void transform(int, int, char*, const char*, size_t);
+
 // socket correspondence
 int sendMessage(char*, int);
 int recvMessage(char*, int, int);
+uint32_t crc32c(uint32_t, const char*, size_t);
+void sendFrame(const char*, size_t, int, int);
+char* recvFrame(size_t*, int, int);
 
 // socket
 // void addressSetup(struct sockaddr_in*, int);
 void socketConnect(int, struct sockaddr_in*);
 
+// client
+int parseOptions(int, char**, int, struct options*);
+void validateText(const char*, size_t, const char*);
+char* readfromfile(const char*, size_t*, int);
+void validateConnection(const char*, int, int);
+void resolveHost(int, struct sockaddr_in*);
+int clientConnect(const struct sockaddr_in*);
+void* transferStripe(void*);
+void runClient(const char*, const char*, const char*, int,
+    const struct options*);
+
+// daemon
+int authenticateConnection(int, int*, int);
+void serveConnection(int, int);
+void runDaemon(int, int);
+
 // prints
 void error(const char*, int);
 
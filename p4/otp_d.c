@@ -0,0 +1,38 @@
+/* ****************************************************************************
+ * Name:    Jenny Huang
+ * Date:    November 26, 2019
+ * Description: otp_d.c
+ * This program is run in the background as a daemon. It combines otp_enc_d
+ * and otp_dec_d: both otp_enc and otp_dec may connect on the same port, and
+ * the transform is chosen per request from the tag the client sends.
+ * An error is printed if it can't be run due to a network error, such as the
+ * ports being unavailable. This program supports up to five concurrent 
+ * socket connections running at the same time.
+ * This program is ran as follows:
+ *    otp_d port &
+ * where 
+ *    port is the port that the program attemps to connect otp_d on
+ * **************************************************************************/
+#include "otp.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ****************************************************************************
+ * Description:
+ * main program
+ * ***************************************************************************/
+int main(int argc, char* argv[]) {
+  // print error if invalid number of arguments
+  if (argc < 2) {
+    fprintf(stderr, "USAGE: %s port\n", argv[0]);
+    exit(1);
+  }
+
+  // get port number
+  int port = atoi(argv[1]); // Get the port number from argument
+
+  // serve both otp_enc and otp_dec requests from one process tree
+  runDaemon(port, MODE_ENC | MODE_DEC);
+
+  return 0;
+}
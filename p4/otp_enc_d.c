@@ -16,59 +16,6 @@
 #include "otp.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <string.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netdb.h>
-
-/* ****************************************************************************
- * function declarations
- * ***************************************************************************/
-// encryption
-void encrypt(char*, char*);
-
-void authenticateConnection(char* tag, int socketFD);
-/* ****************************************************************************
- * Description:
- * encrypts text considering OTP
- * @param text
- * @param key
- * ***************************************************************************/
-void encrypt(char* text, char* key) {
-  int n = strlen(text); // length of plaintext
-  int k = strlen(key);  // length of key
-
-  // printf("key:\n%s\n", key);  printf("plain text:\n%s\n", text);
-  int i = 0;
-  for (; i < n; i++) {
-    int val = chtoval(text[i]) + chtoval(key[i]);
-    text[i] = valtoch(val);
-  }
-  // printf("cipher text:\n%s\n", text);
-}
-
-/* ****************************************************************************
- * Description:
- * authenticates if connection can be made
- * @param tag
- * @param socketFD
- * ***************************************************************************/
-void authenticateConnection(char* tag, int socketFD) {
-  char buffer[BUFFER];
-  memset(buffer, '\0', sizeof(buffer));
-
-  // receive validation message from client
-  recvMessage(buffer, sizeof(buffer), socketFD);
-
-  // authenticate if buffer matches tag
-  if (strcmp(buffer, tag) != 0) 
-    error("error: attempt to connect terminated", 2);
-
-  // authenticate by sending acceptance
-  sendMessage(ACCEPT, socketFD);
-}
 
 /* ****************************************************************************
  * Description:
@@ -84,82 +31,8 @@ int main(int argc, char* argv[]) {
   // get port number
   int port = atoi(argv[1]); // Get the port number from argument
 
-  socklen_t sizeOfClientInfo;
-  char buffer[BUFFER];
-  memset(buffer, '\0', sizeof(buffer));
-  char key[BUFFER];
-  memset(key, '\0', sizeof(key));
-
-  // set up address struct for process
-  struct sockaddr_in serverAddress, clientAddress;
-  memset((char *)&serverAddress, '\0', sizeof(serverAddress)); // Clear address
-
-  serverAddress.sin_family = AF_INET; // Create a network-capable socket
-  serverAddress.sin_port = htons(port); // Store the port number
-  serverAddress.sin_addr.s_addr = INADDR_ANY; // Any address is allowed for connection to this process
-  // addrSetup(&serverAddress, port);
-
-  // set up socket
-  int listenSocketFD, establishedConnectionFD;  
-  listenSocketFD = socket(AF_INET, SOCK_STREAM, 0); // create socket
-  if (listenSocketFD < 0) error("error: server unable to open socket", 0);
-  //socketSetup(&listenSocketFD);
-
-  // enable socket to begin listening
-  // Connect socket to port
-  if (bind(listenSocketFD, (struct sockaddr *)&serverAddress, 
-        sizeof(serverAddress)) < 0) 
-    error("error: server unable to bind", 0);
-
-  // Flip the socket on - it can now receive up to 5 connections
-  if (listen(listenSocketFD, 5) < 0) 
-    error("error: server unable to listen", 0);
-
-  // wait for connection request from client
-  int status = -5;
-  while (1) {
-    // accept connection, blocking if one isn't available until one connects
-    sizeOfClientInfo = sizeof(clientAddress); // Get the size of the address 
-    establishedConnectionFD = accept(listenSocketFD, 
-        (struct sockaddr*)&clientAddress, &sizeOfClientInfo);  // accept
-    if (establishedConnectionFD < 0) 
-      error("error: server unable to accept", 0);
-
-    // fork request
-    pid_t pid = fork();
-    switch (pid) {
-      case -1:  // error 
-        error("error: server unable to create fork", 0);
-        break;
-      case 0:  // successful: get plaintext/key from client, send ciphertext 
-        // authenticate client
-        authenticateConnection(ENC_TAG, establishedConnectionFD);
-
-        // read plaintext
-        recvMessage(buffer, sizeof(buffer), establishedConnectionFD);
-        // printf("SERVER received plaintext: %s\n", buffer);
-        // read key
-        recvMessage(key, sizeof(key), establishedConnectionFD);
-        // printf("SERVER received key: %s\n", key);
-
-        // encrypt plaintext
-        encrypt(buffer, key);
-        // printf("SERVER ciphertext: %s\n", buffer);
-
-        // write ciphertext to socket
-        sendMessage(buffer, establishedConnectionFD);
-
-        close(establishedConnectionFD); // Close the existing socket which is connected to the client
-        break;
-      default:  // parent process
-        close(establishedConnectionFD);
-        while (pid > 0) {
-          pid = waitpid(-1, &status, WNOHANG);
-        }
-        break;
-    }
-  }
-  close(listenSocketFD); // Close the listening socket
+  // serve only otp_enc requests
+  runDaemon(port, MODE_ENC);
 
   return 0;
 }